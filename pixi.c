@@ -6,31 +6,145 @@
 #include <string.h>
 #include <wchar.h>
 #include <jpeglib.h>
+#include <setjmp.h>
 #include <ctype.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <limits.h>
 #include <signal.h>
-#include <sys/time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <termios.h>
+#include <poll.h>
 #include "pixiv.h"
-
-#define PIXEL(pixels, width, x, y, c) ((pixels)[((y) * (width) + (x)) * 3 + (c)])
+#include "pixii.h"
+#include "pixiq.h"
+#include "pixir.h"
+#include "pixis.h"
+#include "pixit.h"
+#include "pixib.h"
+#include "pixim.h"
+#include "pixia.h"
+#include "pixic.h"
+#include "pixik.h"
+#include "pixil.h"
+#include "pixiw.h"
+#include "pixif.h"
+
+// after a still image: colors reset, cursor on the line below it
+#define IMAGE_END "\033[0m\n"
+#define IMAGE_END_LEN 5
 
 // shutdown flag
 volatile sig_atomic_t should_exit = 0;
 
+// terminal resized, the video decode thread picks it up at the next frame
+// lock free atomic => safe to set from the handler, read from any thread
+_Atomic int resize_pending = 0;
+
 // benchmark flag
 int benchmark_enabled = 0;
 
+// benchmark without a terminal, frames go to /dev/null or are only counted
+typedef enum {
+    HEADLESS_OFF,
+    HEADLESS_NULL,
+    HEADLESS_COUNT
+} HeadlessMode;
+
+HeadlessMode headless_mode = HEADLESS_OFF;
+
+// frames are written here, /dev/null when headless
+int output_fd = STDOUT_FILENO;
+
+// live metrics, a status line under the video and / or json lines to a
+// file or unix socket every stats_interval_ms
+int stats_overlay = 0;
+const char *stats_target = NULL;
+int stats_interval_ms = 1000;
+
+// fixed character grid instead of the terminal's, 0 => ask the terminal
+int forced_cols = 0;
+int forced_rows = 0;
+
+// frames in flight between each pair of video pipeline stages
+int queue_depth = 3;
+
+// video => downscale with the box filter instead of inside swscale
+int box_scale_enabled = 0;
+
+// threads for box filter downscaling, 0 => one per core
+int scale_threads = 0;
+
+// pace video by frame pts against the wall clock, dropping late frames
+// off in benchmark mode so throughput is measured
+int sync_enabled = 1;
+
+// codec threading / skip levels, adaptive unless --full-decode
+VideoDecoderOptions decode_options;
+
+// export => encode the video once into a pre-rendered stream file instead
+// of playing it, with a full repaint key frame every EXPORT_KEY_INTERVAL
+// seconds so replay can seek
+const char *export_path = NULL;
+#define EXPORT_KEY_INTERVAL 1.0
+
+// replay starts at the last key frame before this
+double seek_seconds = 0.0;
+
+// images => reuse rendered bytes from the on-disk cache, --no-cache bypasses
+int cache_enabled = 1;
+size_t cache_max_bytes = RENDER_CACHE_DEFAULT_BYTES;
+
+// REP / ECH run length escapes, -1 => whatever the terminal is known to support
+int run_length_mode = -1;
+
+// frames as kitty graphics protocol images instead of text cells
+// -1 => text, otherwise a KittyTransfer
+int kitty_mode = -1;
+
+// the terminal's cell size in pixels when it doesn't report one
+#define KITTY_CELL_WIDTH 8
+#define KITTY_CELL_HEIGHT 16
+
+// unread shm frames the terminal can lag behind the write stage by
+// before a name is reused
+#define KITTY_SHM_LAG 8
+
+// every file on the command line plays at once, tiled
+int grid_enabled = 0;
+
+// serve => publish the video to viewers on this unix socket instead of
+// playing it, connect => show what a server publishes
+const char *serve_path = NULL;
+const char *connect_path = NULL;
+
+// how long viewers get to catch up once the video has ended
+#define SERVE_DRAIN_MS 2000
+
+// --colors, --glyphs, --delta, --lossy, ... for every encoder pixi creates
+EncodeOptions encode_options;
+
 void handle_sigint(int sig) {
     (void)sig;
     should_exit = 1;
 }
 
+void handle_sigwinch(int sig) {
+    (void)sig;
+    atomic_store(&resize_pending, 1);
+}
+
 wchar_t * lowerH = L"▄";
 
 typedef enum {
     FILE_TYPE_UNKNOWN,
     FILE_TYPE_IMAGE,
-    FILE_TYPE_VIDEO
+    FILE_TYPE_VIDEO,
+    FILE_TYPE_STREAM  // pre-rendered by --export
 } FileType;
 
 const char *IMAGE_EXTENSIONS[] = {".jpg", ".jpeg", ".png", ".gif", ".bmp", ".tiff", ".webp", NULL};
@@ -64,432 +178,1888 @@ FileType detect_file_type(const char *path) {
         }
     }
 
+    if (strcmp(lower_ext, ANSI_STREAM_EXTENSION) == 0) {
+        return FILE_TYPE_STREAM;
+    }
+
     return FILE_TYPE_UNKNOWN;
 }
 
-unsigned char* decode_jpeg(const char *path, int *width, int *height){
-    FILE * f = fopen(path, "rb");
-    if(!f){
+void get_terminal_size(int *term_height, int *term_width){
+    if (forced_cols > 0 && forced_rows > 0) {
+        *term_height = forced_rows;
+        *term_width = forced_cols;
+        return;
+    }
+
+    // not a terminal => classic 80x24
+    struct winsize w;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) < 0 || w.ws_row == 0 || w.ws_col == 0) {
+        *term_height = 24;
+        *term_width = 80;
+        return;
+    }
+    *term_height = w.ws_row;
+    *term_width = w.ws_col;
+}
+
+// RUN_REP / RUN_ECH the terminal is known to handle, from the environment
+// there is no query for either, so anything unrecognized gets plain glyphs
+int detect_run_length_support(void) {
+    const char *term = getenv("TERM");
+    const char *program = getenv("TERM_PROGRAM");
+    const char *vte = getenv("VTE_VERSION");
+
+    // tmux parses both itself and redraws in whatever the outer terminal has
+    if (getenv("TMUX")) {
+        return RUN_REP | RUN_ECH;
+    }
+    if (!term) {
+        return 0;
+    }
+    // screen has no REP and erases to the default background unless bce is on
+    if (strncmp(term, "screen", 6) == 0) {
+        return 0;
+    }
+    // the console erases to the active background but has no REP
+    if (strcmp(term, "linux") == 0) {
+        return RUN_ECH;
+    }
+
+    if (strstr(term, "kitty") || strncmp(term, "foot", 4) == 0 ||
+        strncmp(term, "alacritty", 9) == 0 || strncmp(term, "wezterm", 7) == 0 ||
+        getenv("KITTY_WINDOW_ID") || getenv("WT_SESSION") || getenv("XTERM_VERSION") ||
+        (program && (strcmp(program, "WezTerm") == 0 || strcmp(program, "mintty") == 0)) ||
+        (vte && atoi(vte) >= 5400)) {
+        return RUN_REP | RUN_ECH;
+    }
+    return 0;
+}
+
+// kitty => shm unless the terminal is on the other end of an ssh session,
+// where it can't see our /dev/shm
+int detect_kitty_transfer(void) {
+    if (getenv("SSH_CONNECTION") || getenv("SSH_TTY")) {
+        return KITTY_TRANSFER_DIRECT;
+    }
+    return KITTY_TRANSFER_SHM;
+}
+
+static void kitty_cell_size(int *cell_width, int *cell_height){
+    if (kitty_cell_pixels(STDOUT_FILENO, cell_width, cell_height) < 0) {
+        *cell_width = KITTY_CELL_WIDTH;
+        *cell_height = KITTY_CELL_HEIGHT;
+    }
+}
+
+// cells a kitty image of the source's aspect covers, the last row stays
+// free like it does for text frames
+static void kitty_placement(int width, int height, int term_width, int term_height, int *cols, int *rows){
+    int cell_width, cell_height, fit_width, fit_height;
+    kitty_cell_size(&cell_width, &cell_height);
+    fit_aspect(width, height, term_width * cell_width, (term_height - 1) * cell_height,
+               &fit_width, &fit_height);
+
+    *cols = (fit_width + cell_width / 2) / cell_width;
+    *rows = (fit_height + cell_height / 2) / cell_height;
+    if (*cols < 1) *cols = 1;
+    if (*rows < 1) *rows = 1;
+}
+
+void calculate_scaled_dimensions(int width, int height, int term_width, int term_height, int *scaled_width, int *scaled_height){
+    if (kitty_mode >= 0) {
+        // kitty => real pixels, as many as the window shows but never more
+        // than the source has, the terminal does any upscaling
+        int cell_width, cell_height, fit_width, fit_height;
+        kitty_cell_size(&cell_width, &cell_height);
+        fit_aspect(width, height, term_width * cell_width, (term_height - 1) * cell_height,
+                   &fit_width, &fit_height);
+        if (fit_width > width || fit_height > height) {
+            fit_width = width;
+            fit_height = height;
+        }
+        *scaled_width = fit_width;
+        *scaled_height = fit_height;
+        return;
+    }
+
+    // the last row stays free for the shell prompt / status line
+    glyph_grid_size(encode_options.glyph_mode, width, height, term_width, term_height - 1,
+                    scaled_width, scaled_height);
+}
+
+// libjpeg's default error_exit calls exit(), this one jumps back into
+// decode_jpeg_scaled so a corrupt or unsupported jpeg only fails the decode
+typedef struct {
+    struct jpeg_error_mgr mgr;
+    jmp_buf recover;
+} JpegError;
+
+static void jpeg_error_exit(j_common_ptr cinfo) {
+    JpegError *err = (JpegError *)cinfo->err;
+    longjmp(err->recover, 1);
+}
+
+// decode a jpeg straight to scaled_width x scaled_height for the terminal
+// libjpeg's dct scaling skips most of the idct for big photos, the rest is
+// box filtered scanline by scanline as rows arrive
+// => memory is one source row + the output, never the full image
+// NULL on error, quietly if the file is not a jpeg at all or libjpeg can't
+// decode it (truncated, cmyk, ...) => the caller falls back to libav
+unsigned char* decode_jpeg_scaled(const char *path, int term_width, int term_height,
+                                  int *width, int *height, int *scaled_width, int *scaled_height){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
         perror("invalid path");
-        exit(-1);
+        return NULL;
     }
 
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        fprintf(stderr, "Could not read %s\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    // the file is read in place, no stdio buffering
+    unsigned char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+
+    // anything without an soi marker goes straight to libav
+    if (st.st_size < 3 || data[0] != 0xFF || data[1] != 0xD8 || data[2] != 0xFF) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    posix_madvise(data, st.st_size, POSIX_MADV_SEQUENTIAL);
+
     struct jpeg_decompress_struct decomp;
-    struct jpeg_error_mgr decomp_err;
+    JpegError decomp_err;
+
+    // touched after the longjmp => volatile so they aren't left in registers
+    unsigned char * volatile downscaled = NULL;
+    unsigned char * volatile row = NULL;
+    Scaler * volatile scaler = NULL;
 
-    decomp.err = jpeg_std_error(&decomp_err);
+    decomp.err = jpeg_std_error(&decomp_err.mgr);
+    decomp_err.mgr.error_exit = jpeg_error_exit;
     jpeg_create_decompress(&decomp);
-    jpeg_stdio_src(&decomp, f);
+    if (setjmp(decomp_err.recover)) {
+        free(downscaled);
+        downscaled = NULL;
+        goto done;
+    }
+    jpeg_mem_src(&decomp, data, st.st_size);
     jpeg_read_header(&decomp, TRUE);
-    jpeg_start_decompress(&decomp);
 
-    *width = decomp.output_width;
-    *height = decomp.output_height;
-    int num_channel = decomp.output_components;
+    *width = decomp.image_width;
+    *height = decomp.image_height;
+    calculate_scaled_dimensions(*width, *height, term_width, term_height, scaled_width, scaled_height);
+
+    // smallest M/8 dct scale still at least the output size, the box filter
+    // averages the rest
+    // libjpeg builds without M/8 support round to the next 1/2^n it has
+    int num = 8;
+    while (num > 1 &&
+           (long)*width * (num - 1) >= (long)*scaled_width * 8 &&
+           (long)*height * (num - 1) >= (long)*scaled_height * 8) {
+        num--;
+    }
+    decomp.scale_num = num;
+    decomp.scale_denom = 8;
+    decomp.dct_method = JDCT_IFAST;
+    decomp.out_color_space = JCS_RGB;
 
-    unsigned char *pixels = malloc(*width * *height * 3);
+    jpeg_start_decompress(&decomp);
+    if (decomp.output_components != 3) {
+        fprintf(stderr, "Unsupported jpeg color space\n");
+        jpeg_abort_decompress(&decomp);
+        goto done;
+    }
 
-    unsigned char *row = malloc(*width * num_channel);
-    while(decomp.output_scanline < *height){
-        int y = decomp.output_scanline;
-        jpeg_read_scanlines(&decomp, &row, 1);
-        for(int x = 0; x < *width; x++){
-            PIXEL(pixels, *width, x, y, 0) = row[x*num_channel + 0];
-            PIXEL(pixels, *width, x, y, 1) = row[x*num_channel + 1];
-            PIXEL(pixels, *width, x, y, 2) = row[x*num_channel + 2];
-        }
+    int decoded_width = decomp.output_width;
+    int decoded_height = decomp.output_height;
+
+    downscaled = malloc(*scaled_width * *scaled_height * 3);
+    row = malloc(decoded_width * 3);
+    scaler = scaler_create(decoded_width, decoded_height, *scaled_width, *scaled_height, 1);
+    if (!downscaled || !row || !scaler) {
+        fprintf(stderr, "Failed to allocate image buffers\n");
+        free(downscaled);
+        downscaled = NULL;
+        jpeg_abort_decompress(&decomp);
+        goto done;
     }
 
-    free(row);
+    scaler_stream_begin(scaler);
+    while(decomp.output_scanline < decomp.output_height){
+        JSAMPROW line = row;
+        jpeg_read_scanlines(&decomp, &line, 1);
+        scaler_stream_row(scaler, row, downscaled, *scaled_width * 3);
+    }
     jpeg_finish_decompress(&decomp);
+
+done:
+    scaler_free(scaler);
+    free(row);
     jpeg_destroy_decompress(&decomp);
-    fclose(f);
+    munmap(data, st.st_size);
 
-    return pixels;
+    return downscaled;
 }
 
-void get_terminal_size(int *term_height, int *term_width){
-    struct winsize w;
-    ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
-    *term_height = w.ws_row;
-    *term_width = w.ws_col;
+// write everything, retrying short writes
+// 0 on success, -1 on error
+int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
 }
 
-void calculate_scaled_dimensions(int width, int height, int term_width, int term_height, int *scaled_width, int *scaled_height){
-    int available_height = (term_height - 1) * 2;
-    int available_width = term_width;
-
-    float img_aspect = (float)width / (float)height;
-    float term_aspect = (float)available_width / (float)available_height;
-
-    if(img_aspect > term_aspect){
-        *scaled_width = available_width;
-        *scaled_height = (int)(available_width / img_aspect);
-    } else {
-        *scaled_height = available_height;
-        *scaled_width = (int)(available_height * img_aspect);
+// frame bytes => output_fd, or nowhere when only counting
+int output_frame(struct iovec *iov, int count) {
+    if (headless_mode == HEADLESS_COUNT) {
+        return 0;
     }
+    return pixi_writev_all(output_fd, iov, count);
 }
 
-unsigned char* downscale_image(unsigned char *pixels, int width, int height, int scaled_width, int scaled_height){
-    unsigned char *downscaled = malloc(scaled_width * scaled_height * 3);
+// benchmark timing: records now - since under series (when benchmarking)
+// and returns now, so consecutive stages chain
+static inline int64_t bench_lap(BenchStats *bench, BenchSeries series, int64_t since) {
+    if (!bench) return 0;
+    int64_t now = clock_now_ns();
+    bench_record(bench, series, now - since);
+    return now;
+}
 
-    for(int y = 0; y < scaled_height; y++){
-        for(int x = 0; x < scaled_width; x++){
-            int src_y = (y * height) / scaled_height;
-            int src_x = (x * width) / scaled_width;
+static inline int64_t bench_start(BenchStats *bench) {
+    return bench ? clock_now_ns() : 0;
+}
 
-            PIXEL(downscaled, scaled_width, x, y, 0) = PIXEL(pixels, width, src_x, src_y, 0);
-            PIXEL(downscaled, scaled_width, x, y, 1) = PIXEL(pixels, width, src_x, src_y, 1);
-            PIXEL(downscaled, scaled_width, x, y, 2) = PIXEL(pixels, width, src_x, src_y, 2);
-        }
+// one kitty image on a cleared screen, the cursor ends up below it like
+// the text renderers leave it
+// returns bytes written, 0 on error
+static size_t render_kitty_image(KittyEncoder *encoder, const unsigned char *pixels, int width, int height,
+                                 int term_width, int term_height, BenchStats *bench){
+    int cols, rows;
+    kitty_placement(width, height, term_width, term_height, &cols, &rows);
+
+    size_t size = kitty_frame_buffer_size(width, height) + 32;
+    char *frame_buffer = malloc(size);
+    if (!frame_buffer) {
+        return 0;
     }
-    return downscaled;
-}
 
-// fast int to string 0-255 no bounds checking
-// returns chars written
-static inline int fast_u8_to_str(unsigned char val, char *buf) {
-    if (val >= 100) {
-        buf[0] = '0' + (val / 100);
-        buf[1] = '0' + ((val / 10) % 10);
-        buf[2] = '0' + (val % 10);
-        return 3;
-    } else if (val >= 10) {
-        buf[0] = '0' + (val / 10);
-        buf[1] = '0' + (val % 10);
-        return 2;
+    int64_t t = bench_start(bench);
+    size_t len = 0;
+    if (!bench) {
+        memcpy(frame_buffer, "\033[2J", 4);
+        len = 4;
+    }
+    size_t image = kitty_encode_frame(encoder, pixels, width, height, width * 3, cols, rows,
+                                      frame_buffer + len);
+    if (image > 0 && !bench) {
+        len += image;
+        len += sprintf(frame_buffer + len, "\033[%d;1H", rows + 1);
     } else {
-        buf[0] = '0' + val;
-        return 1;
+        len = image;
+    }
+    t = bench_lap(bench, BENCH_ENCODE, t);
+
+    if (len > 0) {
+        struct iovec iov = {frame_buffer, len};
+        output_frame(&iov, 1);
+        bench_lap(bench, BENCH_WRITE, t);
     }
+    free(frame_buffer);
+    return len;
 }
 
-size_t calculate_frame_buffer_size(int width, int height) {
-    // worst case per pixel is both colors change:
-    //   "\033[38;2;RRR;GGG;BBB;48;2;RRR;GGG;BBBm▄"
-    //   max is 3 + 18 + 18 + 1 + 3 = 43 bytes
-    // color state tracking => most pixels skip color codes entirely
-    // for each row:
-    //   newline 1 byte
-    //   "\033[H" (3 bytes) to reset cursor position
+unsigned char* allocate_pixel_buffer(int width, int height) {
+    return malloc(width * height * 3);
+}
 
-    int rows = (height + 1) / 2;
-    return 3 + (rows * width * 50) + (rows * 1) + 4;
+void free_pixel_buffer(unsigned char *pixels){
+    free(pixels);
 }
 
-void render_to_terminal_buffered(unsigned char *pixels, int width, int height, char *frame_buffer){
-    char *buf = frame_buffer;
+// cache key for showing path on this grid with the current render settings
+// 0 on success, -1 => don't cache
+static int image_cache_key(const char *path, int term_width, int term_height, char *key, size_t len) {
+    char settings[128];
+    snprintf(settings, sizeof(settings), "%dx%d|c%d|t%d|s%d|r%d|g%d", term_width, term_height,
+             (int)encode_options.color_mode, encode_options.color_tolerance,
+             encode_options.color_snap_bits, encode_options.run_length_flags, (int)encode_options.glyph_mode);
+    return render_cache_key(path, settings, key, len);
+}
 
-    // color state tracking init
-    static int last_fg_r = -1, last_fg_g = -1, last_fg_b = -1;
-    static int last_bg_r = -1, last_bg_g = -1, last_bg_b = -1;
+// a cache hit: the stored bytes go out as they are
+static void show_cached_image(CachedRender *render) {
+    struct iovec iov[2] = {{(void *)render->data, render->len}, {IMAGE_END, IMAGE_END_LEN}};
+    output_frame(iov, 2);
+    getchar();
+}
 
-    // cursor pos reset "\033[H"
-    *buf++ = '\033';
-    *buf++ = '[';
-    *buf++ = 'H';
+void image_pipeline(const char * path){
+    BenchStats stats;
+    BenchStats *bench = benchmark_enabled ? &stats : NULL;
+    if (bench) bench_init(bench);
 
-    // reset state at start of frame **TODO**
-    last_fg_r = last_fg_g = last_fg_b = -1;
-    last_bg_r = last_bg_g = last_bg_b = -1;
+    int term_height, term_width;
+    get_terminal_size(&term_height, &term_width);
 
-    int total_rows = (height + 1) / 2;
-    int current_row = 0;
+    // same file + grid + settings as before => no decode at all
+    // kitty shm frames name objects that are gone once shown => never cached
+    // benchmarks time decode, scale and encode => they neither read nor
+    // fill the user's cache
+    char cache_key[PATH_MAX + 256];
+    int cacheable = cache_enabled && !bench && kitty_mode < 0 &&
+        image_cache_key(path, term_width, term_height, cache_key, sizeof(cache_key)) == 0;
+    CachedRender cached;
+    if (cacheable && render_cache_lookup(cache_key, &cached)) {
+        show_cached_image(&cached);
+        render_cache_release(&cached);
+        return;
+    }
 
-    for(int y = 0; y < height; y += 2){
-        for(int x = 0; x < width; x++){
-            unsigned char r_top = PIXEL(pixels, width, x, y, 0);
-            unsigned char g_top = PIXEL(pixels, width, x, y, 1);
-            unsigned char b_top = PIXEL(pixels, width, x, y, 2);
+    // jpegs => libjpeg's scaled decode, decode and downscale are interleaved
+    // per scanline => one timing
+    int64_t t = bench_start(bench);
+    int width, height, scaled_width, scaled_height;
+    unsigned char *downscaled = decode_jpeg_scaled(path, term_width, term_height,
+                                                   &width, &height, &scaled_width, &scaled_height);
+    if (downscaled) {
+        t = bench_lap(bench, BENCH_DECODE, t);
+    } else {
+        // everything else => libav, converted + downscaled in one swscale pass
+        ImageDecoder *decoder = image_decoder_open(path);
+        if (decoder) {
+            t = bench_lap(bench, BENCH_DECODE, t);
+
+            width = decoder->width;
+            height = decoder->height;
+            calculate_scaled_dimensions(width, height, term_width, term_height, &scaled_width, &scaled_height);
+
+            downscaled = malloc(scaled_width * scaled_height * 3);
+            if (downscaled && image_decoder_scale(decoder, scaled_width, scaled_height,
+                                                  downscaled, scaled_width * 3) < 0) {
+                free(downscaled);
+                downscaled = NULL;
+            }
+            t = bench_lap(bench, BENCH_SCALE, t);
+            image_decoder_close(decoder);
+        }
+    }
+    if (!downscaled) {
+        fprintf(stderr, "Failed to decode image\n");
+        if (bench) bench_free(bench);
+        return;
+    }
 
-            unsigned char r_bot, g_bot, b_bot;
-            if(y + 1 < height){
-                r_bot = PIXEL(pixels, width, x, y+1, 0);
-                g_bot = PIXEL(pixels, width, x, y+1, 1);
-                b_bot = PIXEL(pixels, width, x, y+1, 2);
-            } else {
-                r_bot = g_bot = b_bot = 0;
-            }
-
-            // compare curr color state to needed
-            int fg_changed = (r_bot != last_fg_r || g_bot != last_fg_g || b_bot != last_fg_b);
-            int bg_changed = (r_top != last_bg_r || g_top != last_bg_g || b_top != last_bg_b);
-
-            if (fg_changed && bg_changed) {
-                *buf++ = '\033';
-                *buf++ = '[';
-                *buf++ = '3';
-                *buf++ = '8';
-                *buf++ = ';';
-                *buf++ = '2';
-                *buf++ = ';';
-                buf += fast_u8_to_str(r_bot, buf);
-                *buf++ = ';';
-                buf += fast_u8_to_str(g_bot, buf);
-                *buf++ = ';';
-                buf += fast_u8_to_str(b_bot, buf);
-                *buf++ = ';';
-                *buf++ = '4';
-                *buf++ = '8';
-                *buf++ = ';';
-                *buf++ = '2';
-                *buf++ = ';';
-                buf += fast_u8_to_str(r_top, buf);
-                *buf++ = ';';
-                buf += fast_u8_to_str(g_top, buf);
-                *buf++ = ';';
-                buf += fast_u8_to_str(b_top, buf);
-                *buf++ = 'm';
-
-                last_fg_r = r_bot;
-                last_fg_g = g_bot;
-                last_fg_b = b_bot;
-                last_bg_r = r_top;
-                last_bg_g = g_top;
-                last_bg_b = b_top;
-            } else if (fg_changed) {
-                *buf++ = '\033';
-                *buf++ = '[';
-                *buf++ = '3';
-                *buf++ = '8';
-                *buf++ = ';';
-                *buf++ = '2';
-                *buf++ = ';';
-                buf += fast_u8_to_str(r_bot, buf);
-                *buf++ = ';';
-                buf += fast_u8_to_str(g_bot, buf);
-                *buf++ = ';';
-                buf += fast_u8_to_str(b_bot, buf);
-                *buf++ = 'm';
-
-                last_fg_r = r_bot;
-                last_fg_g = g_bot;
-                last_fg_b = b_bot;
-            } else if (bg_changed) {
-                *buf++ = '\033';
-                *buf++ = '[';
-                *buf++ = '4';
-                *buf++ = '8';
-                *buf++ = ';';
-                *buf++ = '2';
-                *buf++ = ';';
-                buf += fast_u8_to_str(r_top, buf);
-                *buf++ = ';';
-                buf += fast_u8_to_str(g_top, buf);
-                *buf++ = ';';
-                buf += fast_u8_to_str(b_top, buf);
-                *buf++ = 'm';
-
-                last_bg_r = r_top;
-                last_bg_g = g_top;
-                last_bg_b = b_top;
-            }
-
-            // half block is 0xE2 0x96 0x84
-            *buf++ = 0xE2;
-            *buf++ = 0x96;
-            *buf++ = 0x84;
-        }
-
-        current_row++;
-        if (current_row < total_rows) {
-            *buf++ = '\n';
-        }
-    }
-
-    write(STDOUT_FILENO, frame_buffer, buf - frame_buffer);
-}
-
-void render_to_terminal(unsigned char *pixels, int width, int height){
-    printf("\033[2J\033[H");
-
-    for(int y = 0; y < height; y += 2){
-        for(int x = 0; x < width; x++){
-            unsigned char r_top = PIXEL(pixels, width, x, y, 0);
-            unsigned char g_top = PIXEL(pixels, width, x, y, 1);
-            unsigned char b_top = PIXEL(pixels, width, x, y, 2);
-
-            unsigned char r_bot, g_bot, b_bot;
-            if(y + 1 < height){
-                r_bot = PIXEL(pixels, width, x, y+1, 0);
-                g_bot = PIXEL(pixels, width, x, y+1, 1);
-                b_bot = PIXEL(pixels, width, x, y+1, 2);
-            } else {
-                r_bot = g_bot = b_bot = 0;
+    if (kitty_mode >= 0) {
+        KittyEncoder *kitty = kitty_encoder_create(kitty_mode, 2);
+        size_t len = kitty ? render_kitty_image(kitty, downscaled, scaled_width, scaled_height,
+                                                term_width, term_height, bench) : 0;
+        if (!bench) {
+            getchar();
+        } else {
+            bench_record(bench, BENCH_BYTES, (int64_t)len);
+            printf("\nBenchmark Results (%dx%d => %dx%d, kitty):\n", width, height, scaled_width, scaled_height);
+            bench_report(bench, stdout);
+            bench_free(bench);
+        }
+        kitty_encoder_free(kitty);
+    } else {
+        // already at the grid's pixel size => the renderer only encodes
+        PixiRenderer *renderer = pixi_renderer_create(term_width, term_height - 1, &encode_options);
+        ssize_t drawn = renderer ? pixi_renderer_draw_sized(renderer, downscaled, scaled_width, scaled_height,
+                                                            scaled_width * 3, scaled_width, scaled_height) : -1;
+        if (drawn >= 0) {
+            size_t len;
+            const char *frame = pixi_renderer_output(renderer, &len);
+            t = bench_lap(bench, BENCH_ENCODE, t);
+
+            struct iovec iov[2] = {{(void *)frame, len}, {IMAGE_END, IMAGE_END_LEN}};
+            output_frame(iov, bench ? 1 : 2);
+            bench_lap(bench, BENCH_WRITE, t);
+            if (bench) bench_record(bench, BENCH_BYTES, (int64_t)len);
+            if (cacheable) {
+                render_cache_store(cache_key, frame, len, cache_max_bytes);
             }
+        } else {
+            fprintf(stderr, "Failed to render image\n");
+        }
+        pixi_renderer_free(renderer);
 
-            printf("\033[38;2;%d;%d;%dm", r_bot, g_bot, b_bot);
-            printf("\033[48;2;%d;%d;%dm", r_top, g_top, b_top);
-            printf("%s", "▄");
+        if (!bench) {
+            getchar();
+        } else {
+            printf("\nBenchmark Results (%dx%d => %dx%d):\n", width, height, scaled_width, scaled_height);
+            bench_report(bench, stdout);
+            bench_free(bench);
         }
-        printf("\033[0m\n");
     }
 
-    printf("\033[0m");
-    fflush(stdout);
+    free_pixel_buffer(downscaled);
 }
 
-unsigned char* allocate_pixel_buffer(int width, int height) {
-    return malloc(width * height * 3);
+// slot for the decode => encode queue
+// holds a borrowed decoder frame, released once encoded
+// with box scaling frame points at the slot's own pixels instead
+typedef struct {
+    VideoFrame frame;
+    unsigned char *pixels;  // box scaling only, scaled_width * scaled_height * 3
+    size_t pixels_capacity;
+    int resized;            // first frame at a new terminal size
+    int generation;         // Pipeline.generation it was decoded in
+} PixelSlot;
+
+// preallocated slot for the encode => write queue
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+    struct iovec *bands;  // encoded bands inside data, written with one writev
+    int band_count;
+    int band_capacity;
+    double pts;
+    int flags;            // ANSI_FRAME_KEY => full repaint
+    int resized;          // clear the screen before this frame
+    int generation;
+} ByteSlot;
+
+// slot buffers only ever grow, so resizing back and forth settles into
+// no allocation at all
+// 0 on success, -1 on allocation failure (slot keeps its old buffers)
+static int pixel_slot_reserve(PixelSlot *slot, int width, int height) {
+    size_t size = (size_t)width * height * 3;
+    if (size > slot->pixels_capacity) {
+        unsigned char *pixels = realloc(slot->pixels, size);
+        if (!pixels) return -1;
+        slot->pixels = pixels;
+        slot->pixels_capacity = size;
+    }
+    return 0;
 }
 
-void free_pixel_buffer(unsigned char *pixels){
-    free(pixels);
+// encoder sizes the slot, kitty => one image, otherwise text bands
+static int byte_slot_reserve(ByteSlot *slot, FrameEncoder *encoder, KittyEncoder *kitty, int width, int height) {
+    size_t size = kitty ? kitty_frame_buffer_size(width, height)
+                        : frame_encoder_buffer_size(encoder, width, height);
+    if (size > slot->capacity) {
+        char *data = realloc(slot->data, size);
+        if (!data) return -1;
+        slot->data = data;
+        slot->capacity = size;
+    }
+
+    int bands = kitty ? 1 : frame_encoder_band_count(encoder, height);
+    if (bands < 1) bands = 1;
+    if (bands > slot->band_capacity) {
+        struct iovec *iov = realloc(slot->bands, bands * sizeof(struct iovec));
+        if (!iov) return -1;
+        slot->bands = iov;
+        slot->band_capacity = bands;
+    }
+    return 0;
 }
 
-void image_pipeline(const char * path){
-    int width, height;
-    unsigned char *pixels = decode_jpeg(path, &width, &height);
+// stages:
+//   decode thread: video_decoder_next_frame (swscale or box filter downscales)
+//                  into a PixelSlot
+//   encode thread: PixelSlot => escape sequences in a ByteSlot, row bands
+//                  encoded on the encoder's worker threads
+//   main thread:   write ByteSlot to the terminal once its pts is due
+// with a scheduler, frames already too late are dropped right after decode,
+// before they cost any scaling or encoding
+// each edge is a pair of queues, "ready" carries filled slots downstream and
+// "free" hands emptied slots back upstream so nothing is allocated per frame
+// decoded pixels are never copied, the encoder reads the decoder's pool buffer
+// encodes with a FrameEncoder rather than a PixiRenderer: a renderer's bands
+// only live until its next frame, here several encoded frames are in flight
+typedef struct {
+    VideoDecoder *decoder;
+    Scaler *scaler;  // NULL => decoder scales
+    FrameScheduler *scheduler;  // NULL => as fast as possible
+    FrameEncoder *encoder;      // encode thread
+    KittyEncoder *kitty;        // NULL => text cells
+    BenchStats *bench;          // NULL => no per stage timing
+    Metrics *metrics;           // NULL => no live metrics
+    int scaled_width;           // decode thread
+    int scaled_height;
+    _Atomic int term_width;     // written by decode on resize, read by write
+    _Atomic int term_height;
+    AnsiStreamWriter *writer;   // NULL => frames go to the terminal
+    double next_key_pts;        // export only, encode thread
+
+    // seeking: the write thread sets seek_ms, then bumps generation
+    // decode seeks when it sees a new generation, frames from an older one
+    // are dropped wherever they are
+    _Atomic int64_t seek_ms;
+    _Atomic int generation;
+
+    FrameQueue pixels_free;
+    FrameQueue pixels_ready;
+    FrameQueue bytes_free;
+    FrameQueue bytes_ready;
+} Pipeline;
+
+// stage timing for the benchmark and live metrics, both optional
+static inline int64_t stage_start(Pipeline *pl) {
+    return (pl->bench || pl->metrics) ? clock_now_ns() : 0;
+}
+
+// records now - since for the stage, returns now so stages chain
+static inline int64_t stage_lap(Pipeline *pl, BenchSeries series, MetricStage stage, int64_t since) {
+    if (!pl->bench && !pl->metrics) return 0;
+    int64_t now = clock_now_ns();
+    if (pl->bench) bench_record(pl->bench, series, now - since);
+    if (pl->metrics) metrics_record(pl->metrics, stage, now - since);
+    return now;
+}
+
+// status line on the terminal's last row, below the video
+static void draw_status_line(Metrics *metrics, MetricSnapshot *prev, int row, int width) {
+    MetricSnapshot now;
+    metrics_snapshot(metrics, &now);
+
+    char text[512];
+    int len = metrics_format_status(&now, prev, text, sizeof(text));
+    if (len > width) len = width;
+    *prev = now;
+
+    // save cursor, reverse video line, restore => frames don't notice
+    // frames start from unknown colors so the sgr reset is harmless
+    char line[600];
+    int n = snprintf(line, sizeof(line), "\0337\033[%d;1H\033[0;7m%.*s\033[K\033[0m\0338", row, len, text);
+    if (n > 0) {
+        struct iovec iov = {line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1};
+        output_frame(&iov, 1);
+    }
+}
 
+// new terminal geometry without touching the decoder's codec state
+// swscale (or the box scaler) is rebuilt for the new size, frames already
+// in flight keep their old size and buffers
+// 0 => the frames from now on are for the new terminal, -1 => unchanged
+static int pipeline_resize(Pipeline *pl) {
     int term_height, term_width;
     get_terminal_size(&term_height, &term_width);
 
     int scaled_width, scaled_height;
-    calculate_scaled_dimensions(width, height, term_width, term_height, &scaled_width, &scaled_height);
+    calculate_scaled_dimensions(pl->decoder->width, pl->decoder->height, term_width, term_height,
+                                &scaled_width, &scaled_height);
+    if (scaled_width < 1 || scaled_height < 1) {
+        return -1;
+    }
 
-    unsigned char *downscaled = downscale_image(pixels, width, height, scaled_width, scaled_height);
+    if (scaled_width != pl->scaled_width || scaled_height != pl->scaled_height) {
+        if (pl->scaler) {
+            Scaler *scaler = scaler_create(pl->decoder->width, pl->decoder->height,
+                                           scaled_width, scaled_height, scale_threads);
+            if (!scaler) {
+                return -1;
+            }
+            scaler_free(pl->scaler);
+            pl->scaler = scaler;
+        } else if (video_decoder_set_output_size(pl->decoder, scaled_width, scaled_height) < 0) {
+            return -1;
+        }
+        pl->scaled_width = scaled_width;
+        pl->scaled_height = scaled_height;
+    }
 
-    render_to_terminal(downscaled, scaled_width, scaled_height);
+    atomic_store(&pl->term_width, term_width);
+    atomic_store(&pl->term_height, term_height);
+    return 0;
+}
 
-    getchar();
+static void* decode_stage(void *arg) {
+    Pipeline *pl = arg;
+    VideoDecoder *decoder = pl->decoder;
+    int generation = 0;
 
-    free_pixel_buffer(downscaled);
-    free_pixel_buffer(pixels);
+    void *item;
+    while (frame_queue_pop(&pl->pixels_free, &item, &should_exit)) {
+        PixelSlot *slot = item;
+
+        if (atomic_load(&pl->generation) != generation) {
+            generation = atomic_load(&pl->generation);
+            video_decoder_seek(decoder, atomic_load(&pl->seek_ms) / 1000.0);
+            // the clock restarts at the first frame shown from the new position
+            if (pl->scheduler) scheduler_reset(pl->scheduler);
+        }
+        slot->generation = generation;
+
+        // decode until a frame that can still be shown in time
+        int got;
+        double pts;
+        int64_t t = stage_start(pl);
+        do {
+            got = video_decoder_decode(decoder, &pts);
+        } while (got && !should_exit && pl->scheduler && scheduler_should_drop(pl->scheduler, pts));
+
+        if (!got || should_exit) {
+            break;
+        }
+        t = stage_lap(pl, BENCH_DECODE, METRIC_DECODE, t);
+
+        // frame boundary => pick up a terminal resize here
+        slot->resized = 0;
+        if (atomic_exchange(&resize_pending, 0)) {
+            slot->resized = pipeline_resize(pl) == 0;
+        }
+
+        if (!pl->scaler) {
+            // decoder already scaled to scaled_width x scaled_height
+            if (!video_decoder_convert(decoder, &slot->frame)) {
+                break;
+            }
+            stage_lap(pl, BENCH_CONVERT, METRIC_CONVERT, t);
+        } else {
+            VideoFrame source;
+            if (!video_decoder_convert(decoder, &source)) {
+                break;
+            }
+            t = stage_lap(pl, BENCH_CONVERT, METRIC_CONVERT, t);
+
+            if (pixel_slot_reserve(slot, pl->scaled_width, pl->scaled_height) < 0) {
+                fprintf(stderr, "Failed to grow playback buffers\n");
+                video_frame_release(&source);
+                break;
+            }
+            scaler_run(pl->scaler, source.data, source.stride, slot->pixels, pl->scaled_width * 3);
+            video_frame_release(&source);
+            stage_lap(pl, BENCH_SCALE, METRIC_SCALE, t);
+
+            slot->frame.data = slot->pixels;
+            slot->frame.stride = pl->scaled_width * 3;
+            slot->frame.width = pl->scaled_width;
+            slot->frame.height = pl->scaled_height;
+            slot->frame.pts = pts;
+            slot->frame.buf = NULL;
+        }
+
+        if (!frame_queue_push(&pl->pixels_ready, slot, &should_exit)) {
+            video_frame_release(&slot->frame);
+            break;
+        }
+    }
+
+    frame_queue_close(&pl->pixels_ready);
+    return NULL;
+}
+
+static void* encode_stage(void *arg) {
+    Pipeline *pl = arg;
+    int generation = 0;
+    int resized = 0;  // a dropped frame's resize, passed on to the next kept one
+
+    void *item;
+    while (frame_queue_pop(&pl->pixels_ready, &item, &should_exit)) {
+        PixelSlot *pixels = item;
+
+        // decoded before a seek => never shown, not worth encoding
+        if (pixels->generation != atomic_load(&pl->generation)) {
+            resized |= pixels->resized;
+            video_frame_release(&pixels->frame);
+            frame_queue_push(&pl->pixels_free, pixels, &should_exit);
+            continue;
+        }
+
+        if (!frame_queue_pop(&pl->bytes_free, &item, &should_exit)) {
+            video_frame_release(&pixels->frame);
+            break;
+        }
+        ByteSlot *bytes = item;
+
+        VideoFrame *frame = &pixels->frame;
+        if (byte_slot_reserve(bytes, pl->encoder, pl->kitty, frame->width, frame->height) < 0) {
+            fprintf(stderr, "Failed to grow playback buffers\n");
+            video_frame_release(frame);
+            frame_queue_push(&pl->pixels_free, pixels, &should_exit);
+            frame_queue_push(&pl->bytes_free, bytes, &should_exit);
+            // decode would wait on pixels_free forever, stop every stage
+            should_exit = 1;
+            break;
+        }
+
+        // the terminal reflowed whatever was on screen, or frames the delta
+        // state remembers were dropped by a seek => nothing to diff against
+        bytes->resized = pixels->resized || resized;
+        bytes->generation = pixels->generation;
+        resized = 0;
+        if (bytes->resized || pixels->generation != generation) {
+            frame_encoder_reset_delta(pl->encoder);
+            generation = pixels->generation;
+        }
+
+        // exports need regular full repaints to seek to
+        int delta = frame_encoder_options(pl->encoder)->delta;
+        bytes->flags = delta ? 0 : ANSI_FRAME_KEY;
+        if (pl->writer && delta && frame->pts >= pl->next_key_pts) {
+            frame_encoder_reset_delta(pl->encoder);
+            bytes->flags = ANSI_FRAME_KEY;
+            pl->next_key_pts = frame->pts + EXPORT_KEY_INTERVAL;
+        }
+
+        int64_t t = stage_start(pl);
+        if (pl->kitty) {
+            // one image per frame, always a full one
+            int cols, rows;
+            kitty_placement(pl->decoder->width, pl->decoder->height, atomic_load(&pl->term_width),
+                            atomic_load(&pl->term_height), &cols, &rows);
+            bytes->len = kitty_encode_frame(pl->kitty, frame->data, frame->width, frame->height,
+                                            frame->stride, cols, rows, bytes->data);
+            bytes->bands[0].iov_base = bytes->data;
+            bytes->bands[0].iov_len = bytes->len;
+            bytes->band_count = bytes->len > 0;
+            bytes->flags = ANSI_FRAME_KEY;
+        } else {
+            bytes->len = frame_encoder_encode_bands(pl->encoder, frame->data, frame->width, frame->height,
+                                                    frame->stride, bytes->data, bytes->bands, &bytes->band_count);
+        }
+        stage_lap(pl, BENCH_ENCODE, METRIC_ENCODE, t);
+        bytes->pts = frame->pts;
+
+        // pixels are consumed, hand the buffer back to the decoder pool
+        // and the slot back to decode
+        video_frame_release(frame);
+        frame_queue_push(&pl->pixels_free, pixels, &should_exit);
+
+        if (!frame_queue_push(&pl->bytes_ready, bytes, &should_exit)) {
+            break;
+        }
+    }
+
+    frame_queue_close(&pl->bytes_ready);
+    return NULL;
+}
+
+// playback keys, read from stdin in non canonical mode
+typedef enum {
+    KEY_NONE,
+    KEY_PAUSE,  // space / p
+    KEY_SEEK,   // left / right 5s, down / up 60s
+    KEY_QUIT    // q
+} KeyAction;
+
+static struct termios saved_termios;
+
+// no line buffering, no echo, reads never block
+// isig stays on so ctrl+c still reaches handle_sigint
+// 1 if stdin is a terminal now in that mode
+static int keyboard_start(void) {
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &saved_termios) < 0) {
+        return 0;
+    }
+    struct termios raw = saved_termios;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    return tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+}
+
+static void keyboard_stop(void) {
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+}
+
+// next key, waiting up to timeout_ms, *seek in seconds for KEY_SEEK
+static KeyAction keyboard_read(int timeout_ms, double *seek) {
+    struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) <= 0) {
+        return KEY_NONE;
+    }
+
+    unsigned char keys[16];
+    ssize_t n = read(STDIN_FILENO, keys, sizeof(keys));
+    if (n <= 0) {
+        return KEY_NONE;
+    }
+
+    if (keys[0] == ' ' || keys[0] == 'p') return KEY_PAUSE;
+    if (keys[0] == 'q') return KEY_QUIT;
+
+    // arrows are "\033[A" .. "\033[D"
+    if (n >= 3 && keys[0] == '\033' && keys[1] == '[') {
+        switch (keys[2]) {
+            case 'C': *seek = 5.0; return KEY_SEEK;
+            case 'D': *seek = -5.0; return KEY_SEEK;
+            case 'A': *seek = 60.0; return KEY_SEEK;
+            case 'B': *seek = -60.0; return KEY_SEEK;
+        }
+    }
+    return KEY_NONE;
 }
 
 void video_pipeline(const char * path){
-    VideoDecoder *decoder = video_decoder_open(path);
+    int term_height, term_width;
+    get_terminal_size(&term_height, &term_width);
+
+    // adaptive decoding plans for the terminal's pixel grid, not the source
+    int cell_width, cell_height;
+    glyph_cell_size(encode_options.glyph_mode, &cell_width, &cell_height);
+    decode_options.target_width = term_width * cell_width;
+    decode_options.target_height = term_height * cell_height;
+    if (kitty_mode >= 0) {
+        int kitty_width, kitty_height;
+        kitty_cell_size(&kitty_width, &kitty_height);
+        decode_options.target_width = term_width * kitty_width;
+        decode_options.target_height = term_height * kitty_height;
+    }
+
+    VideoDecoder *decoder = video_decoder_open_with_options(path, &decode_options);
     if (!decoder) {
         fprintf(stderr, "Failed to open video: %s\n", path);
         return;
     }
 
-    int term_height, term_width;
-    get_terminal_size(&term_height, &term_width);
-    printf("Terminal resolution: %d x %d\n", term_width, 2 * term_height);
+    printf("Terminal resolution: %d x %d\n", cell_width * term_width, cell_height * term_height);
     int scaled_width, scaled_height;
     calculate_scaled_dimensions(decoder->width, decoder->height,
                                 term_width, term_height,
                                 &scaled_width, &scaled_height);
 
-    int frame_delay_us = (int)(1000000.0 / decoder->fps);
+    // colour conversion + downscale in one swscale pass
+    // box scaling converts at source size and averages afterwards
+    int out_width = box_scale_enabled ? decoder->width : scaled_width;
+    int out_height = box_scale_enabled ? decoder->height : scaled_height;
+    if (video_decoder_set_output_size(decoder, out_width, out_height) < 0) {
+        fprintf(stderr, "Failed to set decoder output size\n");
+        video_decoder_close(decoder);
+        return;
+    }
+
+    FrameScheduler scheduler;
+    scheduler_init(&scheduler, decoder->fps);
+
+    // zeroed => cleanup can destroy queues that were never initialised
+    Pipeline pl = {0};
+    pl.decoder = decoder;
+    pl.scheduler = (sync_enabled && !benchmark_enabled && !export_path) ? &scheduler : NULL;
+
+    BenchStats stats;
+    bench_init(&stats);
+    pl.bench = benchmark_enabled ? &stats : NULL;
+
+    Metrics metrics;
+    metrics_init(&metrics);
+    atomic_store(&metrics.queue_capacity, queue_depth);
+    int overlay = stats_overlay && headless_mode == HEADLESS_OFF && !export_path;
+    pl.metrics = (overlay || stats_target) ? &metrics : NULL;
+    MetricsReporter *reporter = NULL;
+    MetricSnapshot overlay_prev;
+    int64_t overlay_next = 0;
+    pl.scaled_width = scaled_width;
+    pl.scaled_height = scaled_height;
+    atomic_init(&pl.term_width, term_width);
+    atomic_init(&pl.term_height, term_height);
+
+    // slots live in the free queues until a stage takes them
+    PixelSlot *pixel_slots = calloc(queue_depth, sizeof(PixelSlot));
+    ByteSlot *byte_slots = calloc(queue_depth, sizeof(ByteSlot));
+    int ok = pixel_slots && byte_slots;
+    ok = ok && frame_queue_init(&pl.pixels_free, queue_depth) == 0;
+    ok = ok && frame_queue_init(&pl.pixels_ready, queue_depth) == 0;
+    ok = ok && frame_queue_init(&pl.bytes_free, queue_depth) == 0;
+    ok = ok && frame_queue_init(&pl.bytes_ready, queue_depth) == 0;
+
+    if (ok && box_scale_enabled) {
+        pl.scaler = scaler_create(decoder->width, decoder->height, scaled_width, scaled_height, scale_threads);
+        ok = pl.scaler != NULL;
+    }
 
-    size_t buffer_size = calculate_frame_buffer_size(scaled_width, scaled_height);
-    char *frame_buffer = malloc(buffer_size);
-    unsigned char *downscaled = allocate_pixel_buffer(scaled_width, scaled_height);
+    // every queued frame can hold an shm object, plus what the terminal
+    // hasn't read yet
+    if (ok && kitty_mode >= 0) {
+        pl.kitty = kitty_encoder_create(kitty_mode, queue_depth + KITTY_SHM_LAG);
+        ok = pl.kitty != NULL;
+    }
+    if (ok) {
+        pl.encoder = frame_encoder_create(&encode_options);
+        ok = pl.encoder != NULL;
+    }
 
-    if (!frame_buffer || !downscaled) {
+    for (int i = 0; ok && i < queue_depth; i++) {
+        ok = byte_slot_reserve(&byte_slots[i], pl.encoder, pl.kitty, scaled_width, scaled_height) == 0;
+        if (ok && pl.scaler) {
+            ok = pixel_slot_reserve(&pixel_slots[i], scaled_width, scaled_height) == 0;
+        }
+        if (ok) {
+            frame_queue_try_push(&pl.pixels_free, &pixel_slots[i]);
+            frame_queue_try_push(&pl.bytes_free, &byte_slots[i]);
+        }
+    }
+
+    if (!ok) {
         fprintf(stderr, "Failed to allocate playback buffers\n");
-        if (frame_buffer) free(frame_buffer);
-        if (downscaled) free_pixel_buffer(downscaled);
-        video_decoder_close(decoder);
-        return;
+        goto cleanup;
     }
 
-    printf("Starting playback... (Press Ctrl+C to stop)\n");
-    sleep(1);
+    if (export_path) {
+        pl.writer = ansi_stream_create(export_path, term_width, term_height, decoder->fps);
+        if (!pl.writer) {
+            goto cleanup;
+        }
+    }
 
     signal(SIGINT, handle_sigint);
 
-    // alternate screen buffer init
-    printf("\033[?1049h");
-    printf("\033[?25l");// hide cursor
-    printf("\033[2J");// clear
-    fflush(stdout);
+    // a forced --size grid doesn't follow the terminal
+    if (headless_mode == HEADLESS_OFF && !pl.writer && forced_cols == 0) {
+        signal(SIGWINCH, handle_sigwinch);
+    }
+
+    if (headless_mode == HEADLESS_OFF && !pl.writer) {
+        printf("Starting playback... (space: pause, arrows: seek 5s / 60s, q or Ctrl+C: stop)\n");
+        sleep(1);
+
+        // alternate screen buffer init
+        printf("\033[?1049h");
+        printf("\033[?25l");// hide cursor
+        printf("\033[2J");// clear
+        fflush(stdout);
+    }
 
     // benchmark variables
-    struct timeval start_time, end_time;
-    long total_time_us = 0;
+    // stages overlap so per frame time is wall clock / frames written
+    int64_t total_time_ns = 0;
+    int64_t start_ns = clock_now_ns();
     int frame_count = 0;
 
-    // playback
-    unsigned char *frame;
-    while ((frame = video_decoder_next_frame(decoder)) != NULL && !should_exit) {
-        if (benchmark_enabled) {
-            gettimeofday(&start_time, NULL);
-        }
+    if (stats_target) {
+        reporter = metrics_reporter_start(&metrics, stats_target, stats_interval_ms);
+    }
+    if (overlay) {
+        metrics_snapshot(&metrics, &overlay_prev);
+    }
 
-        for(int y = 0; y < scaled_height; y++){
-            for(int x = 0; x < scaled_width; x++){
-                int src_y = (y * decoder->height) / scaled_height;
-                int src_x = (x * decoder->width) / scaled_width;
+    // a stage that can't start => everything stops, the write loop below
+    // falls straight through and only started threads are joined
+    pthread_t decode_thread, encode_thread;
+    int decode_started = pthread_create(&decode_thread, NULL, decode_stage, &pl) == 0;
+    int encode_started = decode_started && pthread_create(&encode_thread, NULL, encode_stage, &pl) == 0;
+    if (!encode_started) {
+        fprintf(stderr, "Failed to start pipeline threads\n");
+        should_exit = 1;
+    }
 
-                PIXEL(downscaled, scaled_width, x, y, 0) = PIXEL(frame, decoder->width, src_x, src_y, 0);
-                PIXEL(downscaled, scaled_width, x, y, 1) = PIXEL(frame, decoder->width, src_x, src_y, 1);
-                PIXEL(downscaled, scaled_width, x, y, 2) = PIXEL(frame, decoder->width, src_x, src_y, 2);
+    // keys only make sense when playing to a terminal
+    int keyboard = headless_mode == HEADLESS_OFF && !pl.writer && keyboard_start();
+    int paused = 0;
+    int show_next = 0;     // paused, but show where a seek landed
+    int clear_pending = 0; // a dropped frame was the first at a new size
+    double shown_pts = 0.0;
+
+    // playback => write stage
+    void *item;
+    while (!should_exit) {
+        if (keyboard) {
+            double seek = 0.0;
+            KeyAction key = keyboard_read(paused && !show_next ? 50 : 0, &seek);
+            if (key == KEY_QUIT) {
+                should_exit = 1;
+                break;
+            } else if (key == KEY_PAUSE) {
+                paused = !paused;
+                // resuming => the clock picks up from the next frame
+                if (!paused && pl.scheduler) scheduler_reset(pl.scheduler);
+            } else if (key == KEY_SEEK) {
+                double target = shown_pts + seek;
+                if (decoder->duration > 0 && target > decoder->duration - 1.0) target = decoder->duration - 1.0;
+                if (target < 0.0) target = 0.0;
+                shown_pts = target;  // repeated presses add up
+                atomic_store(&pl.seek_ms, (int64_t)(target * 1000.0));
+                atomic_fetch_add(&pl.generation, 1);
+                show_next = paused;
             }
+            if (paused && !show_next) {
+                continue;
+            }
+        }
+
+        if (!frame_queue_pop(&pl.bytes_ready, &item, &should_exit)) {
+            break;
         }
+        ByteSlot *bytes = item;
 
-        render_to_terminal_buffered(downscaled, scaled_width, scaled_height, frame_buffer);
+        // encoded before a seek, a resize it carried still needs its clear
+        if (bytes->generation != atomic_load(&pl.generation)) {
+            clear_pending |= bytes->resized;
+            frame_queue_push(&pl.bytes_free, bytes, &should_exit);
+            continue;
+        }
+        show_next = 0;
+        shown_pts = bytes->pts;
 
-        if (benchmark_enabled) {
-            gettimeofday(&end_time, NULL);
-            long elapsed_us = (end_time.tv_sec - start_time.tv_sec) * 1000000L +
-                             (end_time.tv_usec - start_time.tv_usec);
-            total_time_us += elapsed_us;
-            frame_count++;
+        if (pl.scheduler) {
+            scheduler_wait(pl.scheduler, bytes->pts);
         }
 
-        //usleep(frame_delay_us);
+        int64_t t = stage_start(&pl);
+        if (pl.writer) {
+            // a broken export is useless, stop decoding
+            if (ansi_stream_add(pl.writer, bytes->bands, bytes->band_count, bytes->pts, bytes->flags) < 0) {
+                should_exit = 1;
+            }
+        } else {
+            if (bytes->resized || clear_pending) {
+                // leftovers of the old layout outside the new frame
+                struct iovec clear = {CLEAR_SCREEN, CLEAR_SCREEN_LEN};
+                output_frame(&clear, 1);
+                clear_pending = 0;
+            }
+            if (bytes->len > 0) {
+                output_frame(bytes->bands, bytes->band_count);
+            }
+        }
+        if (pl.bench) {
+            bench_lap(pl.bench, BENCH_WRITE, t);
+            bench_record(pl.bench, BENCH_BYTES, (int64_t)bytes->len);
+        }
+        if (pl.metrics) {
+            int64_t now = clock_now_ns();
+            metrics_record_frame(pl.metrics, bytes->len, now - t);
+            atomic_store_explicit(&metrics.pixels_queued, (int)frame_queue_size(&pl.pixels_ready), memory_order_relaxed);
+            atomic_store_explicit(&metrics.bytes_queued, (int)frame_queue_size(&pl.bytes_ready), memory_order_relaxed);
+            if (pl.scheduler) {
+                atomic_store_explicit(&metrics.dropped, atomic_load(&scheduler.dropped), memory_order_relaxed);
+                atomic_store_explicit(&metrics.late, atomic_load(&scheduler.late), memory_order_relaxed);
+            }
+
+            if (overlay && now >= overlay_next) {
+                draw_status_line(&metrics, &overlay_prev, atomic_load(&pl.term_height), atomic_load(&pl.term_width));
+                overlay_next = now + 500000000LL;
+            }
+        }
+        frame_count++;
+
+        frame_queue_push(&pl.bytes_free, bytes, &should_exit);
     }
 
-    // cleanup
-    free(frame_buffer);
-    free_pixel_buffer(downscaled);
+    if (decode_started) pthread_join(decode_thread, NULL);
+    if (encode_started) pthread_join(encode_thread, NULL);
+    metrics_reporter_stop(reporter);
+    signal(SIGWINCH, SIG_DFL);
+
+    total_time_ns = clock_now_ns() - start_ns;
 
     // restore terminal
-    printf("\033[?25h"); // show cursor
-    printf("\033[?1049l");
-    fflush(stdout);
+    if (keyboard) {
+        keyboard_stop();
+    }
+    if (headless_mode == HEADLESS_OFF && !pl.writer) {
+        if (pl.kitty) {
+            printf(KITTY_DELETE_IMAGE);
+        }
+        printf("\033[?25h"); // show cursor
+        printf("\033[?1049l");
+        fflush(stdout);
+    }
 
-    if (should_exit) {
+    if (pl.writer) {
+        // interrupted exports are kept, every frame written so far is indexed
+        if (ansi_stream_finish(pl.writer) == 0) {
+            printf("Exported %d frames for %dx%d to %s\n", frame_count, term_width, term_height, export_path);
+        }
+        pl.writer = NULL;
+    } else if (should_exit) {
         printf("Playback interrupted by user.\n");
     } else {
         printf("Playback finished!\n");
     }
 
+    if (pl.scheduler) {
+        printf("Frames shown: %d, dropped: %d, late: %d\n", frame_count,
+               atomic_load(&scheduler.dropped), atomic_load(&scheduler.late));
+    }
+
     // print benchmark results
     if (benchmark_enabled && frame_count > 0) {
-        double avg_time_ms = (double)total_time_us / (double)frame_count / 1000.0;
+        double avg_time_ms = (double)total_time_ns / (double)frame_count / 1000000.0;
         double avg_fps = 1000.0 / avg_time_ms;
-        printf("\nBenchmark Results:\n");
+        printf("\nBenchmark Results (%dx%d => %dx%d):\n", decoder->width, decoder->height, scaled_width, scaled_height);
         printf("  Total frames processed: %d\n", frame_count);
+        printf("  Pipeline queue depth: %d\n", queue_depth);
         printf("  Average time per frame: %.3f ms\n", avg_time_ms);
         printf("  Average FPS: %.2f\n", avg_fps);
-        printf("  Total processing time: %.3f s\n", (double)total_time_us / 1000000.0);
+        printf("  Total processing time: %.3f s\n", (double)total_time_ns / 1000000000.0);
+        printf("\n");
+        bench_report(&stats, stdout);
     }
 
+cleanup:
+    for (int i = 0; i < queue_depth; i++) {
+        // frames still queued when playback was interrupted
+        if (pixel_slots) video_frame_release(&pixel_slots[i].frame);
+        if (pixel_slots && pixel_slots[i].pixels) free_pixel_buffer(pixel_slots[i].pixels);
+        if (byte_slots && byte_slots[i].data) free(byte_slots[i].data);
+        if (byte_slots && byte_slots[i].bands) free(byte_slots[i].bands);
+    }
+    scaler_free(pl.scaler);
+    kitty_encoder_free(pl.kitty);
+    frame_encoder_free(pl.encoder);
+    bench_free(&stats);
+    free(pixel_slots);
+    free(byte_slots);
+    frame_queue_destroy(&pl.pixels_free);
+    frame_queue_destroy(&pl.pixels_ready);
+    frame_queue_destroy(&pl.bytes_free);
+    frame_queue_destroy(&pl.bytes_ready);
+
     video_decoder_close(decoder);
 }
 
+// play a stream written by --export
+// no decode, scale or encode, frames go from the mapping straight to write
+void replay_pipeline(const char *path){
+    AnsiStream *stream = ansi_stream_open(path);
+    if (!stream) {
+        return;
+    }
+    const AnsiStreamHeader *header = stream->header;
+
+    int term_height, term_width;
+    get_terminal_size(&term_height, &term_width);
+    if ((int)header->cols != term_width || (int)header->rows != term_height) {
+        fprintf(stderr, "Warning: rendered for %ux%u, terminal is %dx%d\n",
+                header->cols, header->rows, term_width, term_height);
+    }
+
+    FrameScheduler scheduler;
+    scheduler_init(&scheduler, header->fps);
+    FrameScheduler *sync = (sync_enabled && !benchmark_enabled) ? &scheduler : NULL;
+
+    BenchStats stats;
+    BenchStats *bench = benchmark_enabled ? &stats : NULL;
+    if (bench) bench_init(bench);
+
+    signal(SIGINT, handle_sigint);
+
+    if (headless_mode == HEADLESS_OFF) {
+        printf("\033[?1049h");
+        printf("\033[?25l");// hide cursor
+        printf("\033[2J");// clear
+        fflush(stdout);
+    }
+
+    // the scheduler's clock starts at the first frame's pts => seeking is
+    // just starting further into the index
+    uint32_t first = ansi_stream_seek(stream, seek_seconds);
+    int64_t start_ns = clock_now_ns();
+    int frame_count = 0;
+
+    for (uint32_t i = first; i < header->frame_count && !should_exit; i++) {
+        size_t len;
+        const unsigned char *data = ansi_stream_frame(stream, i, &len);
+
+        if (sync) {
+            scheduler_wait(sync, stream->index[i].pts_us / 1000000.0);
+        }
+
+        int64_t t = bench_start(bench);
+        if (len > 0) {
+            struct iovec iov = {(void *)data, len};
+            output_frame(&iov, 1);
+        }
+        if (bench) {
+            bench_lap(bench, BENCH_WRITE, t);
+            bench_record(bench, BENCH_BYTES, (int64_t)len);
+        }
+        frame_count++;
+    }
+
+    int64_t total_time_ns = clock_now_ns() - start_ns;
+
+    if (headless_mode == HEADLESS_OFF) {
+        printf("\033[?25h"); // show cursor
+        printf("\033[?1049l");
+        fflush(stdout);
+    }
+
+    if (should_exit) {
+        printf("Playback interrupted by user.\n");
+    } else {
+        printf("Playback finished!\n");
+    }
+    if (sync) {
+        printf("Frames shown: %d, late: %d\n", frame_count, atomic_load(&scheduler.late));
+    }
+
+    if (bench && frame_count > 0) {
+        printf("\nBenchmark Results (replay %ux%u):\n", header->cols, header->rows);
+        printf("  Total frames processed: %d\n", frame_count);
+        printf("  Average FPS: %.2f\n", frame_count / ((double)total_time_ns / 1000000000.0));
+        printf("\n");
+        bench_report(bench, stdout);
+    }
+    if (bench) bench_free(bench);
+
+    ansi_stream_close(stream);
+}
+
+// several videos tiled on one screen, see pixiw.h
+// a tick per frame of the fastest video on one clock, every tile with a
+// new frame goes out in the same write
+void grid_pipeline(const char **paths, int count){
+    int term_height, term_width;
+    get_terminal_size(&term_height, &term_width);
+
+    // the last row stays free, like single video playback
+    VideoWall *wall = video_wall_open(paths, count, term_width, term_height - 1,
+                                      &encode_options, &decode_options);
+    if (!wall) {
+        return;
+    }
+
+    int64_t tick_ns = (int64_t)(1000000000.0 / video_wall_fps(wall));
+    int sync = sync_enabled && !benchmark_enabled;
+
+    BenchStats stats;
+    BenchStats *bench = benchmark_enabled ? &stats : NULL;
+    if (bench) bench_init(bench);
+
+    signal(SIGINT, handle_sigint);
+    if (headless_mode == HEADLESS_OFF && forced_cols == 0) {
+        signal(SIGWINCH, handle_sigwinch);
+    }
+
+    if (headless_mode == HEADLESS_OFF) {
+        printf("Starting %d videos... (space: pause, q or Ctrl+C: stop)\n", count);
+        sleep(1);
+
+        printf("\033[?1049h");
+        printf("\033[?25l");// hide cursor
+        fflush(stdout);
+    }
+
+    int keyboard = headless_mode == HEADLESS_OFF && keyboard_start();
+    int paused = 0;
+    int64_t paused_ns = 0;
+
+    // synced => video time is wall time since start minus pauses, tiles
+    // drop what they fall behind on
+    // otherwise every tick advances one frame of the fastest video
+    int64_t start_ns = clock_now_ns();
+    int64_t next_ns = start_ns;
+    int64_t video_ns = 0;
+    int64_t total_bytes = 0;
+    int ticks = 0;
+
+    while (!should_exit && !video_wall_finished(wall)) {
+        if (keyboard) {
+            double seek = 0.0;
+            KeyAction key = keyboard_read(paused ? 50 : 0, &seek);
+            if (key == KEY_QUIT) {
+                should_exit = 1;
+                break;
+            } else if (key == KEY_PAUSE) {
+                paused = !paused;
+                if (paused) {
+                    paused_ns = clock_now_ns();
+                } else {
+                    int64_t now = clock_now_ns();
+                    start_ns += now - paused_ns;
+                    next_ns = now;
+                }
+            }
+        }
+
+        // paused => the tick only repaints the new layout
+        int resized = atomic_exchange(&resize_pending, 0);
+        if (resized) {
+            get_terminal_size(&term_height, &term_width);
+            // too small for every tile => keep drawing the old layout
+            video_wall_resize(wall, term_width, term_height - 1);
+        }
+        if (paused && !resized) {
+            continue;
+        }
+
+        // paused => video time stays where it stopped
+        if (!paused && sync) {
+            clock_sleep_until_ns(next_ns);
+            int64_t now = clock_now_ns();
+            video_ns = now - start_ns;
+            // behind by more than a tick (slow terminal) => no burst to catch up
+            next_ns += tick_ns;
+            if (next_ns <= now) next_ns = now + tick_ns;
+        } else if (!paused) {
+            video_ns = (int64_t)ticks * tick_ns;
+        }
+
+        int64_t t = bench_start(bench);
+        struct iovec *bands;
+        int band_count;
+        size_t len = video_wall_tick(wall, video_ns / 1000000000.0, &bands, &band_count);
+        t = bench_lap(bench, BENCH_ENCODE, t);
+        if (band_count > 0) {
+            output_frame(bands, band_count);
+        }
+        if (bench) {
+            bench_lap(bench, BENCH_WRITE, t);
+            bench_record(bench, BENCH_BYTES, (int64_t)len);
+        }
+        total_bytes += len;
+        ticks++;
+    }
+
+    int64_t total_time_ns = clock_now_ns() - start_ns;
+    signal(SIGWINCH, SIG_DFL);
+
+    if (keyboard) {
+        keyboard_stop();
+    }
+    if (headless_mode == HEADLESS_OFF) {
+        printf("\033[?25h"); // show cursor
+        printf("\033[?1049l");
+        fflush(stdout);
+    }
+
+    if (should_exit) {
+        printf("Playback interrupted by user.\n");
+    } else {
+        printf("Playback finished!\n");
+    }
+    printf("Frames shown: %d, dropped: %d\n", video_wall_shown(wall), video_wall_dropped(wall));
+
+    if (bench && ticks > 0) {
+        double seconds = (double)total_time_ns / 1000000000.0;
+        printf("\nBenchmark Results (%d videos, %dx%d):\n", count, term_width, term_height);
+        printf("  Ticks: %d\n", ticks);
+        printf("  Average ticks per second: %.2f\n", ticks / seconds);
+        printf("  Average bytes per tick: %.0f\n", (double)total_bytes / ticks);
+        printf("  Total processing time: %.3f s\n", seconds);
+        printf("\n");
+        bench_report(bench, stdout);
+    }
+    if (bench) bench_free(bench);
+
+    video_wall_close(wall);
+}
+
+// decode once, encode once per group of viewers sharing a setup, see pixif.h
+// plays in real time while anyone watches, waits while nobody does
+void serve_pipeline(const char *path){
+    // viewers' grids aren't known up front => decode at full size, every
+    // group box filters down to its own grid
+    decode_options.adaptive = 0;
+    VideoDecoder *decoder = video_decoder_open_with_options(path, &decode_options);
+    if (!decoder) {
+        fprintf(stderr, "Failed to open video: %s\n", path);
+        return;
+    }
+    if (video_decoder_set_output_size(decoder, decoder->width, decoder->height) < 0) {
+        fprintf(stderr, "Failed to set decoder output size\n");
+        video_decoder_close(decoder);
+        return;
+    }
+
+    FrameServer *server = frame_server_create(serve_path, &encode_options);
+    if (!server) {
+        video_decoder_close(decoder);
+        return;
+    }
+
+    FrameScheduler scheduler;
+    scheduler_init(&scheduler, decoder->fps);
+
+    signal(SIGINT, handle_sigint);
+    printf("Serving %s on %s (Ctrl+C: stop)\n", path, serve_path);
+    fflush(stdout);
+
+    int frame_count = 0;
+    int failed = 0;
+    while (!should_exit && !failed) {
+        // nobody watching => nothing decoded, the clock restarts with the
+        // first viewer
+        if (frame_server_viewers(server) == 0) {
+            failed = frame_server_poll(server, 100) < 0;
+            scheduler_reset(&scheduler);
+            continue;
+        }
+
+        double pts;
+        int got;
+        do {
+            got = video_decoder_decode(decoder, &pts);
+        } while (got && !should_exit && scheduler_should_drop(&scheduler, pts));
+        if (!got) {
+            break;
+        }
+
+        VideoFrame frame;
+        if (!video_decoder_convert(decoder, &frame)) {
+            continue;
+        }
+
+        // viewers keep being served until the frame is due
+        int64_t due = scheduler_due_ns(&scheduler, pts);
+        int64_t now;
+        while (!should_exit && !failed && (now = clock_now_ns()) < due) {
+            failed = frame_server_poll(server, (int)((due - now + 999999) / 1000000)) < 0;
+        }
+        if (failed) {
+            video_frame_release(&frame);
+            break;
+        }
+
+        frame_server_publish(server, frame.data, frame.width, frame.height, frame.stride);
+        video_frame_release(&frame);
+        failed = frame_server_poll(server, 0) < 0;
+        frame_count++;
+    }
+
+    if (failed) {
+        fprintf(stderr, "Serving stopped: the listening socket failed\n");
+    } else if (should_exit) {
+        printf("Serving interrupted by user.\n");
+    } else {
+        // the last frames are still on their way to slower viewers
+        frame_server_drain(server, SERVE_DRAIN_MS);
+        printf("Serving finished!\n");
+    }
+    printf("Frames decoded: %d, dropped: %d, encoded: %d, skipped by slow viewers: %d\n", frame_count,
+           atomic_load(&scheduler.dropped), frame_server_encoded(server), frame_server_skipped(server));
+
+    frame_server_free(server);
+    video_decoder_close(decoder);
+}
+
+// show a --serve process' video, the server renders for this terminal
+void connect_pipeline(void){
+    int fd = frame_client_connect(connect_path);
+    if (fd < 0) {
+        return;
+    }
+
+    // the grid single video playback would use
+    int term_height, term_width;
+    get_terminal_size(&term_height, &term_width);
+    if (frame_client_hello(fd, term_width, term_height - 1, &encode_options) < 0) {
+        fprintf(stderr, "Failed to reach the server\n");
+        close(fd);
+        return;
+    }
+
+    signal(SIGINT, handle_sigint);
+    if (headless_mode == HEADLESS_OFF && forced_cols == 0) {
+        signal(SIGWINCH, handle_sigwinch);
+    }
+
+    if (headless_mode == HEADLESS_OFF) {
+        printf("\033[?1049h");
+        printf("\033[?25l");// hide cursor
+        fflush(stdout);
+    }
+
+    int keyboard = headless_mode == HEADLESS_OFF && keyboard_start();
+    struct pollfd fds[2] = {{fd, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+    static char buf[65536];
+    int64_t total_bytes = 0;
+    int ended = 0;
+
+    while (!should_exit) {
+        if (atomic_exchange(&resize_pending, 0)) {
+            get_terminal_size(&term_height, &term_width);
+            frame_client_hello(fd, term_width, term_height - 1, &encode_options);
+        }
+
+        if (poll(fds, keyboard ? 2 : 1, 100) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (keyboard && (fds[1].revents & POLLIN)) {
+            double seek;
+            if (keyboard_read(0, &seek) == KEY_QUIT) {
+                should_exit = 1;
+                break;
+            }
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                ended = 1;
+                break;
+            }
+            // frames arrive whole and in order, chunk boundaries don't matter
+            struct iovec iov = {buf, n};
+            output_frame(&iov, 1);
+            total_bytes += n;
+        }
+    }
+
+    signal(SIGWINCH, SIG_DFL);
+    if (keyboard) {
+        keyboard_stop();
+    }
+    if (headless_mode == HEADLESS_OFF) {
+        printf("\033[?25h"); // show cursor
+        printf("\033[?1049l");
+        fflush(stdout);
+    }
+    close(fd);
+
+    if (ended) {
+        printf("Stream ended.\n");
+    } else {
+        printf("Disconnected.\n");
+    }
+    printf("Received %lld bytes\n", (long long)total_bytes);
+}
+
+void print_usage(const char *prog){
+    fprintf(stderr, "Usage: %s [options] <image_or_video_file>\n", prog);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --benchmark    Time every stage, report p50/p95/p99 and bytes per frame\n");
+    fprintf(stderr, "  --headless [count]  Benchmark without a terminal, frames go to /dev/null\n");
+    fprintf(stderr, "                 (or are only counted), grid from --size or 160x48\n");
+    fprintf(stderr, "  --stats        Live status line: stage latencies, fps, queues, drops, stalls\n");
+    fprintf(stderr, "  --stats-out target  Append json lines to a file, or unix:/path socket\n");
+    fprintf(stderr, "  --stats-interval ms  How often --stats-out reports (default 1000)\n");
+    fprintf(stderr, "  --size CxR     Render for C columns x R rows instead of the terminal size\n");
+    fprintf(stderr, "  --delta        Only redraw changed cells (video only)\n");
+    fprintf(stderr, "  --delta-threshold F  Delta, with a full repaint above this fraction of\n");
+    fprintf(stderr, "                 changed cells, 0 < F <= 1 (default 0.5)\n");
+    fprintf(stderr, "  --queue-depth  Frames buffered between pipeline stages (default 3)\n");
+    fprintf(stderr, "  --box-scale    Downscale video with the box filter instead of swscale\n");
+    fprintf(stderr, "  --scale-threads n  Threads for box filter downscaling (default: all cores)\n");
+    fprintf(stderr, "  --colors mode  truecolor (default), 256 or 16\n");
+    fprintf(stderr, "  --glyphs mode  half (default, 1x2 pixels per cell), quadrant (2x2),\n");
+    fprintf(stderr, "                 sextant (2x3) or braille (2x4)\n");
+    fprintf(stderr, "  --lossy n      Reuse colors at most n levels off per channel (default 0 = exact)\n");
+    fprintf(stderr, "  --snap bits    Drop low bits per channel before comparing colors (0-5)\n");
+    fprintf(stderr, "  --run-length mode  Flat runs as REP / ECH escapes: auto (default, only on\n");
+    fprintf(stderr, "                 terminals known to support them), on or off\n");
+    fprintf(stderr, "  --kitty [mode] Show frames as kitty graphics protocol images: shm (pixels in\n");
+    fprintf(stderr, "                 shared memory) or direct (through the terminal, zlib + base64),\n");
+    fprintf(stderr, "                 default shm unless over ssh\n");
+    fprintf(stderr, "  --encode-threads n  Threads encoding row bands (default: all cores)\n");
+    fprintf(stderr, "  --no-sync      Play video as fast as possible instead of in real time\n");
+    fprintf(stderr, "  --decode-threads n  Codec threads (default: one per core)\n");
+    fprintf(stderr, "  --slice-threads     Slice threading only, lower latency than frame threading\n");
+    fprintf(stderr, "  --lowres n     Decode at 1/2^n size where the codec supports it\n");
+    fprintf(stderr, "  --skip-loop-filter  Skip deblocking on all frames\n");
+    fprintf(stderr, "  --skip-frames  Skip decoding non reference frames\n");
+    fprintf(stderr, "  --full-decode  Don't lower decode quality for small terminals\n");
+    fprintf(stderr, "  --export file.pxa  Encode the video once for this terminal size instead\n");
+    fprintf(stderr, "                 of playing it, play the result with pixi file.pxa\n");
+    fprintf(stderr, "  --seek seconds Start replaying a .pxa file this far in\n");
+    fprintf(stderr, "  --no-cache     Don't read or write the rendered image cache\n");
+    fprintf(stderr, "  --cache-size MB  Rendered image cache limit (default 64)\n");
+    fprintf(stderr, "  --grid         Play every video given at once, tiled, one write per frame\n");
+    fprintf(stderr, "  --serve socket Decode + encode the video once for every viewer connected\n");
+    fprintf(stderr, "                 to this unix socket instead of playing it\n");
+    fprintf(stderr, "  --connect socket  Watch a --serve process, --colors / --glyphs /\n");
+    fprintf(stderr, "                 --run-length apply, no file needed\n");
+}
+
 int main(int argc, char * args[]){
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s [--benchmark] <image_or_video_file>\n", args[0]);
-        fprintf(stderr, "Options:\n");
-        fprintf(stderr, "  --benchmark    Enable benchmark mode (video only)\n");
+        print_usage(args[0]);
         return 1;
     }
 
     const char * path = NULL;
 
+    // --grid plays all of them
+    const char **paths = calloc(argc, sizeof(char *));
+    int path_count = 0;
+    if (!paths) {
+        return 1;
+    }
+
+    video_decoder_default_options(&decode_options);
+    decode_options.adaptive = 1;
+
+    // 0 => one per core, resolved after parsing
+    encode_default_options(&encode_options);
+    encode_options.threads = 0;
+
     // parse arguments
     for (int i = 1; i < argc; i++) {
         if (strcmp(args[i], "--benchmark") == 0 || strcmp(args[i], "-b") == 0) {
             benchmark_enabled = 1;
+        } else if (strcmp(args[i], "--headless") == 0) {
+            benchmark_enabled = 1;
+            headless_mode = HEADLESS_NULL;
+            if (i + 1 < argc && strcmp(args[i + 1], "count") == 0) {
+                headless_mode = HEADLESS_COUNT;
+                i++;
+            }
+        } else if (strcmp(args[i], "--stats") == 0) {
+            stats_overlay = 1;
+        } else if (strcmp(args[i], "--stats-out") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --stats-out needs a file or unix:/path\n");
+                return 1;
+            }
+            stats_target = args[++i];
+        } else if (strcmp(args[i], "--stats-interval") == 0) {
+            if (i + 1 >= argc || atoi(args[i + 1]) < 1) {
+                fprintf(stderr, "Error: --stats-interval needs milliseconds\n");
+                return 1;
+            }
+            stats_interval_ms = atoi(args[++i]);
+        } else if (strcmp(args[i], "--size") == 0) {
+            if (i + 1 >= argc || sscanf(args[i + 1], "%dx%d", &forced_cols, &forced_rows) != 2 ||
+                forced_cols < 1 || forced_rows < 2) {
+                fprintf(stderr, "Error: --size needs COLSxROWS, e.g. 160x48\n");
+                return 1;
+            }
+            i++;
+        } else if (strcmp(args[i], "--delta") == 0 || strcmp(args[i], "-d") == 0) {
+            encode_options.delta = 1;
+        } else if (strcmp(args[i], "--delta-threshold") == 0) {
+            // its own flag => a file name is never taken for the threshold
+            char *end = NULL;
+            double threshold = i + 1 < argc ? strtod(args[i + 1], &end) : 0.0;
+            if (!end || end == args[i + 1] || *end != '\0' || !(threshold > 0.0 && threshold <= 1.0)) {
+                fprintf(stderr, "Error: --delta-threshold needs a fraction, 0 < F <= 1\n");
+                return 1;
+            }
+            encode_options.delta = 1;
+            encode_options.delta_threshold = (float)threshold;
+            i++;
+        } else if (strcmp(args[i], "--queue-depth") == 0 || strcmp(args[i], "-q") == 0) {
+            if (i + 1 >= argc || atoi(args[i + 1]) < 1) {
+                fprintf(stderr, "Error: --queue-depth needs a positive number\n");
+                return 1;
+            }
+            queue_depth = atoi(args[++i]);
+        } else if (strcmp(args[i], "--colors") == 0 || strcmp(args[i], "-c") == 0) {
+            const char *mode = i + 1 < argc ? args[++i] : "";
+            if (strcmp(mode, "truecolor") == 0 || strcmp(mode, "24bit") == 0) {
+                encode_options.color_mode = COLOR_MODE_TRUECOLOR;
+            } else if (strcmp(mode, "256") == 0) {
+                encode_options.color_mode = COLOR_MODE_256;
+            } else if (strcmp(mode, "16") == 0) {
+                encode_options.color_mode = COLOR_MODE_16;
+            } else {
+                fprintf(stderr, "Error: --colors needs truecolor, 256 or 16\n");
+                return 1;
+            }
+        } else if (strcmp(args[i], "--glyphs") == 0 || strcmp(args[i], "-g") == 0) {
+            const char *mode = i + 1 < argc ? args[++i] : "";
+            if (strcmp(mode, "half") == 0) {
+                encode_options.glyph_mode = GLYPH_HALF;
+            } else if (strcmp(mode, "quadrant") == 0) {
+                encode_options.glyph_mode = GLYPH_QUADRANT;
+            } else if (strcmp(mode, "sextant") == 0) {
+                encode_options.glyph_mode = GLYPH_SEXTANT;
+            } else if (strcmp(mode, "braille") == 0) {
+                encode_options.glyph_mode = GLYPH_BRAILLE;
+            } else {
+                fprintf(stderr, "Error: --glyphs needs half, quadrant, sextant or braille\n");
+                return 1;
+            }
+        } else if (strcmp(args[i], "--lossy") == 0) {
+            if (i + 1 >= argc || !isdigit((unsigned char)args[i + 1][0])) {
+                fprintf(stderr, "Error: --lossy needs a tolerance (0 = exact)\n");
+                return 1;
+            }
+            encode_options.color_tolerance = atoi(args[++i]);
+        } else if (strcmp(args[i], "--snap") == 0) {
+            if (i + 1 >= argc || atoi(args[i + 1]) < 0 || atoi(args[i + 1]) > 5) {
+                fprintf(stderr, "Error: --snap needs 0-5 bits\n");
+                return 1;
+            }
+            encode_options.color_snap_bits = atoi(args[++i]);
+        } else if (strcmp(args[i], "--run-length") == 0) {
+            const char *mode = i + 1 < argc ? args[++i] : "";
+            if (strcmp(mode, "auto") == 0) {
+                run_length_mode = -1;
+            } else if (strcmp(mode, "on") == 0) {
+                run_length_mode = RUN_REP | RUN_ECH;
+            } else if (strcmp(mode, "off") == 0) {
+                run_length_mode = 0;
+            } else {
+                fprintf(stderr, "Error: --run-length needs auto, on or off\n");
+                return 1;
+            }
+        } else if (strcmp(args[i], "--kitty") == 0) {
+            kitty_mode = -2;  // resolved after parsing
+            // optional transfer
+            if (i + 1 < argc && strcmp(args[i + 1], "shm") == 0) {
+                kitty_mode = KITTY_TRANSFER_SHM;
+                i++;
+            } else if (i + 1 < argc && strcmp(args[i + 1], "direct") == 0) {
+                kitty_mode = KITTY_TRANSFER_DIRECT;
+                i++;
+            }
+        } else if (strcmp(args[i], "--encode-threads") == 0) {
+            if (i + 1 >= argc || atoi(args[i + 1]) < 1) {
+                fprintf(stderr, "Error: --encode-threads needs a positive number\n");
+                return 1;
+            }
+            encode_options.threads = atoi(args[++i]);
+        } else if (strcmp(args[i], "--no-sync") == 0) {
+            sync_enabled = 0;
+        } else if (strcmp(args[i], "--decode-threads") == 0) {
+            if (i + 1 >= argc || atoi(args[i + 1]) < 1) {
+                fprintf(stderr, "Error: --decode-threads needs a positive number\n");
+                return 1;
+            }
+            decode_options.thread_count = atoi(args[++i]);
+        } else if (strcmp(args[i], "--slice-threads") == 0) {
+            decode_options.thread_type = FF_THREAD_SLICE;
+        } else if (strcmp(args[i], "--lowres") == 0) {
+            if (i + 1 >= argc || !isdigit((unsigned char)args[i + 1][0])) {
+                fprintf(stderr, "Error: --lowres needs a number (0-3)\n");
+                return 1;
+            }
+            decode_options.lowres = atoi(args[++i]);
+        } else if (strcmp(args[i], "--skip-loop-filter") == 0) {
+            decode_options.skip_loop_filter = AVDISCARD_ALL;
+        } else if (strcmp(args[i], "--skip-frames") == 0) {
+            decode_options.skip_frame = AVDISCARD_NONREF;
+        } else if (strcmp(args[i], "--full-decode") == 0) {
+            decode_options.adaptive = 0;
+        } else if (strcmp(args[i], "--box-scale") == 0) {
+            box_scale_enabled = 1;
+        } else if (strcmp(args[i], "--scale-threads") == 0) {
+            if (i + 1 >= argc || atoi(args[i + 1]) < 1) {
+                fprintf(stderr, "Error: --scale-threads needs a positive number\n");
+                return 1;
+            }
+            scale_threads = atoi(args[++i]);
+        } else if (strcmp(args[i], "--export") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --export needs an output file\n");
+                return 1;
+            }
+            export_path = args[++i];
+        } else if (strcmp(args[i], "--seek") == 0) {
+            if (i + 1 >= argc || atof(args[i + 1]) < 0) {
+                fprintf(stderr, "Error: --seek needs seconds\n");
+                return 1;
+            }
+            seek_seconds = atof(args[++i]);
+        } else if (strcmp(args[i], "--no-cache") == 0) {
+            cache_enabled = 0;
+        } else if (strcmp(args[i], "--cache-size") == 0) {
+            if (i + 1 >= argc || atoi(args[i + 1]) < 1) {
+                fprintf(stderr, "Error: --cache-size needs megabytes\n");
+                return 1;
+            }
+            cache_max_bytes = (size_t)atoi(args[++i]) * 1024 * 1024;
+        } else if (strcmp(args[i], "--grid") == 0) {
+            grid_enabled = 1;
+        } else if (strcmp(args[i], "--serve") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --serve needs a socket path\n");
+                return 1;
+            }
+            serve_path = args[++i];
+        } else if (strcmp(args[i], "--connect") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --connect needs a socket path\n");
+                return 1;
+            }
+            connect_path = args[++i];
         } else {
             path = args[i];
+            paths[path_count++] = args[i];
         }
     }
 
-    if (!path) {
+    if (!path && !connect_path) {
         fprintf(stderr, "Error: No file specified\n");
-        fprintf(stderr, "Usage: %s [--benchmark] <image_or_video_file>\n", args[0]);
+        print_usage(args[0]);
         return 1;
     }
 
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (scale_threads == 0) {
+        scale_threads = cores > 0 ? (int)cores : 1;
+    }
+    if (encode_options.threads == 0) {
+        encode_options.threads = cores > 0 ? (int)cores : 1;
+    }
+    encode_options.run_length_flags = run_length_mode >= 0 ? run_length_mode : detect_run_length_support();
+    if (kitty_mode == -2) {
+        kitty_mode = detect_kitty_transfer();
+    }
+
+    if (headless_mode != HEADLESS_OFF) {
+        // same grid on every machine => comparable numbers
+        if (forced_cols == 0) {
+            forced_cols = 160;
+            forced_rows = 48;
+        }
+        if (headless_mode == HEADLESS_NULL) {
+            output_fd = open("/dev/null", O_WRONLY);
+            if (output_fd < 0) {
+                fprintf(stderr, "Error: could not open /dev/null\n");
+                return 1;
+            }
+        }
+    }
+
+    // the viewer renders nothing itself
+    if (connect_path) {
+        if (path || serve_path || grid_enabled || export_path || kitty_mode >= 0) {
+            fprintf(stderr, "Error: --connect takes no file and no other mode\n");
+            return 1;
+        }
+        free(paths);
+        connect_pipeline();
+        return 0;
+    }
+
+    if (serve_path) {
+        // viewers get text cells for their own terminals
+        if (detect_file_type(path) != FILE_TYPE_VIDEO || grid_enabled || export_path || kitty_mode >= 0) {
+            fprintf(stderr, "Error: --serve needs one video and no --grid, --export or --kitty\n");
+            return 1;
+        }
+        free(paths);
+        serve_pipeline(path);
+        return 0;
+    }
+
+    if (grid_enabled) {
+        for (int i = 0; i < path_count; i++) {
+            if (detect_file_type(paths[i]) != FILE_TYPE_VIDEO) {
+                fprintf(stderr, "Error: --grid plays videos, %s isn't one\n", paths[i]);
+                return 1;
+            }
+        }
+        // tiles are text cells at their own origins
+        if (export_path || kitty_mode >= 0) {
+            fprintf(stderr, "Error: --grid can't be combined with --export or --kitty\n");
+            return 1;
+        }
+        grid_pipeline(paths, path_count);
+        free(paths);
+        return 0;
+    }
+    free(paths);
+
     FileType file_type = detect_file_type(path);
 
+    if (export_path && file_type != FILE_TYPE_VIDEO) {
+        fprintf(stderr, "Error: --export needs a video\n");
+        return 1;
+    }
+    // .pxa files are text cells for one grid
+    if (export_path && kitty_mode >= 0) {
+        fprintf(stderr, "Error: --export renders text cells, drop --kitty\n");
+        return 1;
+    }
+
     switch (file_type) {
         case FILE_TYPE_IMAGE:
             image_pipeline(path);
@@ -497,10 +2067,14 @@ int main(int argc, char * args[]){
         case FILE_TYPE_VIDEO:
             video_pipeline(path);
             break;
+        case FILE_TYPE_STREAM:
+            replay_pipeline(path);
+            break;
         case FILE_TYPE_UNKNOWN:
             fprintf(stderr, "Unknown file type: %s\n", path);
             fprintf(stderr, "Supported image formats: jpg, jpeg, png, gif, bmp, tiff, webp\n");
             fprintf(stderr, "Supported video formats: mp4, avi, mkv, mov, wmv, flv, webm, m4v\n");
+            fprintf(stderr, "Pre-rendered streams (--export): pxa\n");
             return 1;
     }
 
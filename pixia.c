@@ -0,0 +1,221 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pixia.h"
+
+#define BYTE_ORDER_MARK 0x01020304u
+
+struct AnsiStreamWriter {
+    int fd;
+    char *path;
+    AnsiStreamHeader header;
+    AnsiFrameEntry *index;
+    uint32_t index_capacity;
+    uint64_t offset;  // where the next frame goes
+    int failed;
+};
+
+// whole buffer at offset, 0 on success, -1 on error
+static int pwrite_all(int fd, const void *data, size_t len, off_t offset) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+AnsiStreamWriter* ansi_stream_create(const char *path, int cols, int rows, double fps) {
+    AnsiStreamWriter *writer = calloc(1, sizeof(AnsiStreamWriter));
+    if (!writer) return NULL;
+
+    writer->path = strdup(path);
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (!writer->path || writer->fd < 0) {
+        fprintf(stderr, "Could not create %s: %s\n", path, strerror(errno));
+        if (writer->fd >= 0) close(writer->fd);
+        free(writer->path);
+        free(writer);
+        return NULL;
+    }
+
+    memcpy(writer->header.magic, ANSI_STREAM_MAGIC, sizeof(writer->header.magic));
+    writer->header.version = ANSI_STREAM_VERSION;
+    writer->header.byte_order = BYTE_ORDER_MARK;
+    writer->header.cols = cols;
+    writer->header.rows = rows;
+    writer->header.fps = fps;
+
+    // frames start after the header, which is rewritten once the index exists
+    writer->offset = sizeof(AnsiStreamHeader);
+    return writer;
+}
+
+int ansi_stream_add(AnsiStreamWriter *writer, const struct iovec *bands, int band_count,
+                    double pts, int flags) {
+    if (writer->failed) return -1;
+
+    if (writer->header.frame_count == writer->index_capacity) {
+        uint32_t capacity = writer->index_capacity ? writer->index_capacity * 2 : 1024;
+        AnsiFrameEntry *index = realloc(writer->index, capacity * sizeof(AnsiFrameEntry));
+        if (!index) {
+            fprintf(stderr, "Failed to grow stream index\n");
+            writer->failed = 1;
+            return -1;
+        }
+        writer->index = index;
+        writer->index_capacity = capacity;
+    }
+
+    uint64_t length = 0;
+    for (int i = 0; i < band_count; i++) {
+        if (pwrite_all(writer->fd, bands[i].iov_base, bands[i].iov_len, writer->offset + length) < 0) {
+            fprintf(stderr, "Could not write %s: %s\n", writer->path, strerror(errno));
+            writer->failed = 1;
+            return -1;
+        }
+        length += bands[i].iov_len;
+    }
+
+    AnsiFrameEntry *entry = &writer->index[writer->header.frame_count++];
+    entry->offset = writer->offset;
+    entry->length = length;
+    entry->flags = flags;
+    entry->pts_us = (int64_t)(pts * 1000000.0);
+
+    writer->offset += length;
+    return 0;
+}
+
+int ansi_stream_finish(AnsiStreamWriter *writer) {
+    if (!writer) return -1;
+
+    int ret = writer->failed ? -1 : 0;
+    if (ret == 0) {
+        // 8 byte aligned so the mapped index can be read in place
+        writer->header.index_offset = (writer->offset + 7) & ~(uint64_t)7;
+        size_t index_size = (size_t)writer->header.frame_count * sizeof(AnsiFrameEntry);
+        if (pwrite_all(writer->fd, writer->index, index_size, writer->header.index_offset) < 0 ||
+            pwrite_all(writer->fd, &writer->header, sizeof(AnsiStreamHeader), 0) < 0) {
+            fprintf(stderr, "Could not write %s: %s\n", writer->path, strerror(errno));
+            ret = -1;
+        }
+    }
+
+    if (close(writer->fd) < 0) ret = -1;
+    if (ret < 0) unlink(writer->path);
+
+    free(writer->index);
+    free(writer->path);
+    free(writer);
+    return ret;
+}
+
+AnsiStream* ansi_stream_open(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(AnsiStreamHeader)) {
+        fprintf(stderr, "Not a pixi stream: %s\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    // frames are written to the terminal straight out of the page cache
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+
+    const AnsiStreamHeader *header = data;
+    size_t size = st.st_size;
+    const char *problem = NULL;
+    if (memcmp(header->magic, ANSI_STREAM_MAGIC, sizeof(header->magic)) != 0) {
+        problem = "not a pixi stream";
+    } else if (header->byte_order != BYTE_ORDER_MARK) {
+        problem = "written on a machine with another byte order";
+    } else if (header->version != ANSI_STREAM_VERSION) {
+        problem = "unsupported version";
+    } else if (header->index_offset < sizeof(AnsiStreamHeader) || header->index_offset > size ||
+               (header->index_offset & 7) ||
+               (size - header->index_offset) / sizeof(AnsiFrameEntry) < header->frame_count) {
+        problem = "truncated (export interrupted?)";
+    }
+
+    const AnsiFrameEntry *index = problem ? NULL : (const AnsiFrameEntry *)((const unsigned char *)data + header->index_offset);
+    for (uint32_t i = 0; !problem && i < header->frame_count; i++) {
+        if (index[i].offset > header->index_offset ||
+            index[i].length > header->index_offset - index[i].offset) {
+            problem = "corrupt index";
+        }
+    }
+    // an export of a source without decodable frames has an empty index,
+    // it replays as nothing
+    if (!problem && header->frame_count > 0 && !(index[0].flags & ANSI_FRAME_KEY)) {
+        problem = "corrupt index";
+    }
+
+    AnsiStream *stream = problem ? NULL : malloc(sizeof(AnsiStream));
+    if (!stream) {
+        fprintf(stderr, "%s: %s\n", path, problem ? problem : "out of memory");
+        munmap(data, size);
+        return NULL;
+    }
+
+    // playback reads front to back, seeking jumps are rare
+    posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+
+    stream->data = data;
+    stream->size = size;
+    stream->header = header;
+    stream->index = index;
+    return stream;
+}
+
+uint32_t ansi_stream_seek(const AnsiStream *stream, double seconds) {
+    int64_t target = (int64_t)(seconds * 1000000.0);
+
+    // last frame with pts <= target
+    uint32_t lo = 0, hi = stream->header->frame_count;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (stream->index[mid].pts_us <= target) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // deltas need the screen the key frame draws, frame 0 always is one
+    while (lo > 0 && !(stream->index[lo].flags & ANSI_FRAME_KEY)) {
+        lo--;
+    }
+    return lo;
+}
+
+void ansi_stream_close(AnsiStream *stream) {
+    if (!stream) return;
+
+    munmap((void *)stream->data, stream->size);
+    free(stream);
+}
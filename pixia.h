@@ -0,0 +1,78 @@
+#ifndef PIXIA_H
+#define PIXIA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+// pre-rendered ansi stream, encoded once for a fixed character grid and
+// replayed by writing frames straight out of an mmap'd file
+// layout: header | frame bytes ... | index (one entry per frame)
+// integers are host byte order, the header carries a marker to catch
+// files moved between byte orders
+#define ANSI_STREAM_MAGIC "PIXIANSI"
+#define ANSI_STREAM_VERSION 1
+#define ANSI_STREAM_EXTENSION ".pxa"
+
+// frame draws the whole screen, replay can start / seek here
+// others are deltas against the frame before
+#define ANSI_FRAME_KEY 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;    // 0x01020304 as written
+    uint32_t cols;
+    uint32_t rows;
+    uint32_t frame_count;
+    uint32_t flags;         // unused, 0
+    double fps;
+    uint64_t index_offset;  // AnsiFrameEntry[frame_count] from here
+} AnsiStreamHeader;
+
+typedef struct {
+    uint64_t offset;  // from the start of the file
+    uint32_t length;  // 0 => nothing changed (delta)
+    uint32_t flags;   // ANSI_FRAME_KEY
+    int64_t pts_us;   // presentation time from stream start
+} AnsiFrameEntry;
+
+// export side, frames appended as they are encoded
+typedef struct AnsiStreamWriter AnsiStreamWriter;
+
+// NULL on error
+AnsiStreamWriter* ansi_stream_create(const char *path, int cols, int rows, double fps);
+
+// one frame, written as is from the encoder's bands
+// 0 on success, -1 on error
+int ansi_stream_add(AnsiStreamWriter *writer, const struct iovec *bands, int band_count,
+                    double pts, int flags);
+
+// writes the index + final header and frees the writer
+// 0 on success, -1 on error (the file is removed)
+int ansi_stream_finish(AnsiStreamWriter *writer);
+
+// replay side, the whole file is mapped read only
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    const AnsiStreamHeader *header;
+    const AnsiFrameEntry *index;
+} AnsiStream;
+
+// NULL on error (missing, truncated, other version / byte order)
+// a finished export may hold no frames at all (frame_count 0)
+AnsiStream* ansi_stream_open(const char *path);
+
+// bytes of frame i inside the mapping, no copies
+static inline const unsigned char* ansi_stream_frame(const AnsiStream *stream, uint32_t i, size_t *len) {
+    *len = stream->index[i].length;
+    return stream->data + stream->index[i].offset;
+}
+
+// last key frame at or before seconds, binary search over the index
+uint32_t ansi_stream_seek(const AnsiStream *stream, double seconds);
+
+void ansi_stream_close(AnsiStream *stream);
+
+#endif
@@ -0,0 +1,70 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pixib.h"
+
+static const char *SERIES_NAMES[BENCH_SERIES] = {
+    "decode", "convert", "scale", "encode", "write", "bytes/frame"
+};
+
+void bench_init(BenchStats *stats) {
+    memset(stats, 0, sizeof(BenchStats));
+}
+
+void bench_free(BenchStats *stats) {
+    for (int i = 0; i < BENCH_SERIES; i++) {
+        free(stats->samples[i]);
+    }
+    memset(stats, 0, sizeof(BenchStats));
+}
+
+void bench_record(BenchStats *stats, BenchSeries series, int64_t value) {
+    if (stats->count[series] == stats->capacity[series]) {
+        size_t capacity = stats->capacity[series] ? stats->capacity[series] * 2 : 1024;
+        int64_t *samples = realloc(stats->samples[series], capacity * sizeof(int64_t));
+        if (!samples) return;
+        stats->samples[series] = samples;
+        stats->capacity[series] = capacity;
+    }
+    stats->samples[series][stats->count[series]++] = value;
+}
+
+static int compare_int64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// nearest rank on sorted samples
+static int64_t percentile(const int64_t *sorted, size_t n, int p) {
+    size_t rank = (n * p + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void bench_report(const BenchStats *stats, FILE *out) {
+    fprintf(out, "  %-12s %8s %10s %10s %10s %10s\n", "stage", "samples", "p50", "p95", "p99", "mean");
+
+    for (int i = 0; i < BENCH_SERIES; i++) {
+        size_t n = stats->count[i];
+        if (n == 0) continue;
+
+        int64_t *sorted = malloc(n * sizeof(int64_t));
+        if (!sorted) continue;
+        memcpy(sorted, stats->samples[i], n * sizeof(int64_t));
+        qsort(sorted, n, sizeof(int64_t), compare_int64);
+
+        double sum = 0.0;
+        for (size_t j = 0; j < n; j++) sum += (double)sorted[j];
+
+        // timings in ms, bytes as is
+        double unit = i == BENCH_BYTES ? 1.0 : 1000000.0;
+        const char *fmt = i == BENCH_BYTES
+            ? "  %-12s %8zu %10.0f %10.0f %10.0f %10.0f\n"
+            : "  %-12s %8zu %8.3fms %8.3fms %8.3fms %8.3fms\n";
+        fprintf(out, fmt, SERIES_NAMES[i], n,
+                percentile(sorted, n, 50) / unit,
+                percentile(sorted, n, 95) / unit,
+                percentile(sorted, n, 99) / unit,
+                sum / n / unit);
+        free(sorted);
+    }
+}
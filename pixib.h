@@ -0,0 +1,36 @@
+#ifndef PIXIB_H
+#define PIXIB_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// benchmark series, stage timings in ns plus bytes written per frame
+typedef enum {
+    BENCH_DECODE,
+    BENCH_CONVERT,  // swscale color convert, includes the downscale unless --box-scale
+    BENCH_SCALE,    // box filter downscale
+    BENCH_ENCODE,
+    BENCH_WRITE,
+    BENCH_BYTES,
+    BENCH_SERIES
+} BenchSeries;
+
+// samples per series, grown as needed
+// each series must only ever be recorded from one thread
+typedef struct {
+    int64_t *samples[BENCH_SERIES];
+    size_t count[BENCH_SERIES];
+    size_t capacity[BENCH_SERIES];
+} BenchStats;
+
+void bench_init(BenchStats *stats);
+void bench_free(BenchStats *stats);
+
+// samples that don't fit (out of memory) are dropped
+void bench_record(BenchStats *stats, BenchSeries series, int64_t value);
+
+// p50 / p95 / p99 / mean per series that has samples
+void bench_report(const BenchStats *stats, FILE *out);
+
+#endif
@@ -0,0 +1,266 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pixic.h"
+
+// bump when the encoder's output changes for the same input
+#define CACHE_MAGIC "PIXIRC02"
+#define CACHE_SUFFIX ".ans"
+#define TMP_SUFFIX ".tmp"
+
+// a store takes well under this between open and rename, an older .tmp
+// was left by a process that died mid store
+#define TMP_GRACE_SECONDS 60
+
+// file layout: header | key | rendered bytes
+// the key is stored so a hash collision reads as a miss
+typedef struct {
+    char magic[8];
+    uint32_t key_len;
+    uint32_t reserved;
+    uint64_t data_len;
+} CacheHeader;
+
+// $XDG_CACHE_HOME/pixi or ~/.cache/pixi, created on demand
+// 0 on success, -1 with no usable location
+static int cache_dir(char *dir, size_t len, int create) {
+    const char *base = getenv("XDG_CACHE_HOME");
+    int n;
+    if (base && base[0] == '/') {
+        n = snprintf(dir, len, "%s/pixi", base);
+    } else {
+        const char *home = getenv("HOME");
+        if (!home || home[0] != '/') return -1;
+        n = snprintf(dir, len, "%s/.cache/pixi", home);
+    }
+    if (n < 0 || (size_t)n >= len) return -1;
+
+    if (create && mkdir(dir, 0700) < 0 && errno != EEXIST) {
+        // ~/.cache itself may be missing on a fresh account
+        char *slash = strrchr(dir, '/');
+        *slash = '\0';
+        int parent = mkdir(dir, 0700);
+        *slash = '/';
+        if ((parent < 0 && errno != EEXIST) || mkdir(dir, 0700) < 0) return -1;
+    }
+    return 0;
+}
+
+// fnv-1a, only picks the file, the stored key decides hits
+static uint64_t hash_key(const char *key) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static int cache_path(const char *key, char *path, size_t len, int create) {
+    char dir[PATH_MAX];
+    if (cache_dir(dir, sizeof(dir), create) < 0) return -1;
+
+    int n = snprintf(path, len, "%s/%016llx" CACHE_SUFFIX, dir, (unsigned long long)hash_key(key));
+    return (n < 0 || (size_t)n >= len) ? -1 : 0;
+}
+
+int render_cache_key(const char *path, const char *settings, char *key, size_t len) {
+    char real[PATH_MAX];
+    struct stat st;
+    if (!realpath(path, real) || stat(real, &st) < 0) return -1;
+
+    // any rewrite of the file changes size or mtime (or the inode, for
+    // editors that replace files)
+    int n = snprintf(key, len, "%s|%llu:%llu|%lld|%lld.%09ld|%s", real,
+                     (unsigned long long)st.st_dev, (unsigned long long)st.st_ino,
+                     (long long)st.st_size, (long long)st.st_mtim.tv_sec, st.st_mtim.tv_nsec,
+                     settings);
+    return (n < 0 || (size_t)n >= len) ? -1 : 0;
+}
+
+int render_cache_lookup(const char *key, CachedRender *render) {
+    char path[PATH_MAX];
+    if (cache_path(key, path, sizeof(path), 0) < 0) return 0;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    size_t key_len = strlen(key);
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(CacheHeader) + key_len) {
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return 0;
+    }
+
+    const CacheHeader *header = map;
+    const char *stored_key = (const char *)(header + 1);
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->key_len != key_len || memcmp(stored_key, key, key_len) != 0 ||
+        header->data_len != st.st_size - sizeof(CacheHeader) - key_len) {
+        munmap(map, st.st_size);
+        close(fd);
+        return 0;
+    }
+
+    // mtime is the lru clock, atime is unreliable under relatime / noatime
+    futimens(fd, NULL);
+    close(fd);
+
+    render->map = map;
+    render->map_size = st.st_size;
+    render->data = stored_key + key_len;
+    render->len = header->data_len;
+    return 1;
+}
+
+void render_cache_release(CachedRender *render) {
+    if (render->map) {
+        munmap(render->map, render->map_size);
+    }
+    render->map = NULL;
+    render->data = NULL;
+}
+
+typedef struct {
+    char name[NAME_MAX + 1];
+    off_t size;
+    struct timespec used;
+} CacheFile;
+
+static int by_last_use(const void *a, const void *b) {
+    const struct timespec *x = &((const CacheFile *)a)->used;
+    const struct timespec *y = &((const CacheFile *)b)->used;
+    if (x->tv_sec != y->tv_sec) return x->tv_sec < y->tv_sec ? -1 : 1;
+    return (x->tv_nsec > y->tv_nsec) - (x->tv_nsec < y->tv_nsec);
+}
+
+static int has_suffix(const char *name, size_t name_len, const char *suffix) {
+    size_t suffix_len = strlen(suffix);
+    return name_len > suffix_len && strcmp(name + name_len - suffix_len, suffix) == 0;
+}
+
+// oldest first until the cache fits in max_bytes, keep is never removed
+// stores in progress count toward the size, abandoned ones are removed
+static void evict(const char *keep, size_t max_bytes) {
+    char dir_path[PATH_MAX];
+    if (cache_dir(dir_path, sizeof(dir_path), 0) < 0) return;
+
+    DIR *dir = opendir(dir_path);
+    if (!dir) return;
+
+    CacheFile *files = NULL;
+    size_t count = 0, capacity = 0;
+    uint64_t total = 0;
+
+    time_t now = time(NULL);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t name_len = strlen(entry->d_name);
+        int tmp = has_suffix(entry->d_name, name_len, TMP_SUFFIX);
+        if (!tmp && !has_suffix(entry->d_name, name_len, CACHE_SUFFIX)) {
+            continue;
+        }
+
+        struct stat st;
+        if (fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        if (tmp) {
+            if (now - st.st_mtim.tv_sec > TMP_GRACE_SECONDS) {
+                unlinkat(dirfd(dir), entry->d_name, 0);
+            } else {
+                total += st.st_size;
+            }
+            continue;
+        }
+        total += st.st_size;
+        if (strcmp(entry->d_name, keep) == 0) continue;
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            CacheFile *grown = realloc(files, capacity * sizeof(CacheFile));
+            if (!grown) break;
+            files = grown;
+        }
+        strcpy(files[count].name, entry->d_name);
+        files[count].size = st.st_size;
+        files[count].used = st.st_mtim;
+        count++;
+    }
+
+    if (total > max_bytes && count > 0) {
+        qsort(files, count, sizeof(CacheFile), by_last_use);
+        for (size_t i = 0; i < count && total > max_bytes; i++) {
+            if (unlinkat(dirfd(dir), files[i].name, 0) == 0) {
+                total -= files[i].size;
+            }
+        }
+    }
+
+    free(files);
+    closedir(dir);
+}
+
+int render_cache_store(const char *key, const char *data, size_t len, size_t max_bytes) {
+    char path[PATH_MAX], tmp[PATH_MAX];
+    if (cache_path(key, path, sizeof(path), 1) < 0) return -1;
+
+    // written aside and renamed in => readers never see half a file
+    int n = snprintf(tmp, sizeof(tmp), "%s.%d" TMP_SUFFIX, path, (int)getpid());
+    if (n < 0 || (size_t)n >= sizeof(tmp)) return -1;
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.key_len = strlen(key);
+    header.data_len = len;
+
+    struct { const void *data; size_t len; } parts[3] = {
+        {&header, sizeof(header)}, {key, header.key_len}, {data, len}
+    };
+    int ok = 1;
+    for (int i = 0; ok && i < 3; i++) {
+        const char *p = parts[i].data;
+        size_t left = parts[i].len;
+        while (left > 0) {
+            ssize_t written = write(fd, p, left);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                ok = 0;
+                break;
+            }
+            p += written;
+            left -= written;
+        }
+    }
+
+    if (close(fd) < 0) ok = 0;
+    if (!ok || rename(tmp, path) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+
+    evict(strrchr(path, '/') + 1, max_bytes);
+    return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef PIXIC_H
+#define PIXIC_H
+
+#include <stddef.h>
+
+// on-disk cache of rendered escape bytes, one file per key under
+// $XDG_CACHE_HOME/pixi (or ~/.cache/pixi)
+// a hit is an mmap + write, no decode, scale or encode
+// least recently shown renders are evicted once the directory grows past
+// the limit its writer passes in
+
+// limit without a --cache-size
+#define RENDER_CACHE_DEFAULT_BYTES (64 * 1024 * 1024)
+
+// mapped cache file, data / len are the rendered bytes
+typedef struct {
+    void *map;
+    size_t map_size;
+    const char *data;
+    size_t len;
+} CachedRender;
+
+// key for path as it is on disk now (device, inode, size, mtime) plus
+// settings, which should name everything else the bytes depend on
+// (grid, color mode, ...)
+// 0 on success, -1 if path can't be stat'd or key doesn't fit
+int render_cache_key(const char *path, const char *settings, char *key, size_t len);
+
+// 1 on hit (release the render afterwards), 0 on miss
+int render_cache_lookup(const char *key, CachedRender *render);
+
+void render_cache_release(CachedRender *render);
+
+// store bytes under key, then evict down to max_bytes
+// failures only cost the next run a miss
+// 0 on success, -1 on error
+int render_cache_store(const char *key, const char *data, size_t len, size_t max_bytes);
+
+#endif
@@ -0,0 +1,564 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include "pixif.h"
+#include "pixil.h"
+#include "pixit.h"
+
+#define LISTEN_BACKLOG 16
+
+// one encoded frame shared by every viewer of a group
+// CLEAR_SCREEN_LEN bytes in front of the encoded bytes, filled with
+// CLEAR_SCREEN, sent to viewers starting there and to every viewer when
+// the frame size changed
+// refs: the publisher plus every queue holding it, the server is single
+// threaded so no atomics
+typedef struct {
+    int refs;
+    int key;     // full repaint, a viewer can start here
+    int clear;   // new frame size => everyone clears, not just joiners
+    size_t len;  // encoded bytes after the clear
+    char data[];
+} SharedFrame;
+
+typedef struct {
+    int cols;
+    int rows;
+    ColorMode color_mode;
+    GlyphMode glyph_mode;
+    int run_length_flags;
+
+    PixiRenderer *renderer;  // scaling + delta state, output unused
+
+    int viewers;
+    int key_wanted;  // someone joined or was skipped ahead
+} RenderGroup;
+
+typedef struct {
+    SharedFrame *frame;
+    size_t offset;  // next byte to send, from data
+    size_t start;   // offset it was queued with
+} QueuedFrame;
+
+typedef struct {
+    int fd;
+    RenderGroup *group;  // NULL until the hello
+    char hello[FRAME_HELLO_MAX];
+    int hello_len;
+
+    QueuedFrame queue[FRAME_SERVER_QUEUE];
+    int head;
+    int count;
+    int waiting_key;  // nothing is queued until a full repaint
+} Viewer;
+
+struct FrameServer {
+    int listen_fd;
+    char *socket_path;
+    EncodeOptions options;
+
+    Viewer **viewers;
+    int viewer_count;
+    int viewer_capacity;
+    RenderGroup **groups;
+    int group_count;
+    struct pollfd *pollfds;
+
+    int encoded;
+    int skipped;
+};
+
+static void frame_unref(SharedFrame *frame) {
+    if (--frame->refs == 0) {
+        free(frame);
+    }
+}
+
+static void group_free(RenderGroup *group) {
+    pixi_renderer_free(group->renderer);
+    free(group);
+}
+
+// everything queued goes, apart from a frame already partly sent =>
+// the viewer's terminal never gets half an escape sequence
+static void viewer_drop_queued(Viewer *viewer) {
+    int keep = 0;
+    if (viewer->count > 0) {
+        QueuedFrame *head = &viewer->queue[viewer->head];
+        keep = head->offset != head->start;
+    }
+    for (int i = keep; i < viewer->count; i++) {
+        frame_unref(viewer->queue[(viewer->head + i) % FRAME_SERVER_QUEUE].frame);
+    }
+    viewer->count = keep;
+}
+
+static void leave_group(FrameServer *server, Viewer *viewer) {
+    RenderGroup *group = viewer->group;
+    if (!group) return;
+    viewer->group = NULL;
+
+    if (--group->viewers > 0) return;
+    for (int i = 0; i < server->group_count; i++) {
+        if (server->groups[i] == group) {
+            server->groups[i] = server->groups[--server->group_count];
+            break;
+        }
+    }
+    group_free(group);
+}
+
+static void remove_viewer(FrameServer *server, int index) {
+    Viewer *viewer = server->viewers[index];
+    viewer_drop_queued(viewer);
+    if (viewer->count > 0) {
+        frame_unref(viewer->queue[viewer->head].frame);
+    }
+    leave_group(server, viewer);
+    close(viewer->fd);
+    free(viewer);
+    server->viewers[index] = server->viewers[--server->viewer_count];
+}
+
+// 0 on success, -1 on error
+static int join_group(FrameServer *server, Viewer *viewer, int cols, int rows, ColorMode color_mode,
+                      GlyphMode glyph_mode, int run_length_flags) {
+    leave_group(server, viewer);
+
+    RenderGroup *group = NULL;
+    for (int i = 0; i < server->group_count; i++) {
+        RenderGroup *g = server->groups[i];
+        if (g->cols == cols && g->rows == rows && g->color_mode == color_mode &&
+            g->glyph_mode == glyph_mode && g->run_length_flags == run_length_flags) {
+            group = g;
+            break;
+        }
+    }
+
+    if (!group) {
+        RenderGroup **groups = realloc(server->groups, (server->group_count + 1) * sizeof(RenderGroup *));
+        if (!groups) return -1;
+        server->groups = groups;
+
+        group = calloc(1, sizeof(RenderGroup));
+        if (!group) return -1;
+        group->cols = cols;
+        group->rows = rows;
+        group->color_mode = color_mode;
+        group->glyph_mode = glyph_mode;
+        group->run_length_flags = run_length_flags;
+
+        EncodeOptions options = server->options;
+        options.color_mode = color_mode;
+        options.glyph_mode = glyph_mode;
+        options.run_length_flags = run_length_flags;
+        options.delta = 1;
+        group->renderer = pixi_renderer_create(cols, rows, &options);
+        if (!group->renderer) {
+            free(group);
+            return -1;
+        }
+        server->groups[server->group_count++] = group;
+    }
+
+    group->viewers++;
+    group->key_wanted = 1;
+    viewer->group = group;
+
+    // frames for the old grid are useless now
+    viewer_drop_queued(viewer);
+    viewer->waiting_key = 1;
+    return 0;
+}
+
+// every complete hello line in the buffer
+// 0 on success, -1 => drop the viewer
+static int read_hellos(FrameServer *server, Viewer *viewer) {
+    ssize_t n = read(viewer->fd, viewer->hello + viewer->hello_len,
+                     sizeof(viewer->hello) - 1 - viewer->hello_len);
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+    }
+    if (n == 0) {
+        return -1;
+    }
+    viewer->hello_len += n;
+    viewer->hello[viewer->hello_len] = '\0';
+
+    char *line;
+    while ((line = memchr(viewer->hello, '\n', viewer->hello_len))) {
+        int cols, rows, color_mode, glyph_mode, run_length_flags;
+        if (sscanf(viewer->hello, "PIXI1 %d %d %d %d %d", &cols, &rows, &color_mode, &glyph_mode,
+                   &run_length_flags) != 5 ||
+            cols < 1 || rows < 1 || cols > 4096 || rows > 4096 ||
+            color_mode < COLOR_MODE_TRUECOLOR || color_mode > COLOR_MODE_16 ||
+            glyph_mode < GLYPH_HALF || glyph_mode > GLYPH_BRAILLE ||
+            run_length_flags < 0 || run_length_flags > (RUN_REP | RUN_ECH)) {
+            return -1;
+        }
+        if (join_group(server, viewer, cols, rows, color_mode, glyph_mode, run_length_flags) < 0) {
+            return -1;
+        }
+
+        int used = line + 1 - viewer->hello;
+        viewer->hello_len -= used;
+        memmove(viewer->hello, line + 1, viewer->hello_len + 1);
+    }
+
+    // no newline in a full buffer => not a viewer
+    return viewer->hello_len < (int)sizeof(viewer->hello) - 1 ? 0 : -1;
+}
+
+// queued frames out until the socket is full
+// 0 on success, -1 => drop the viewer
+static int flush_viewer(Viewer *viewer) {
+    while (viewer->count > 0) {
+        struct iovec iov[FRAME_SERVER_QUEUE];
+        for (int i = 0; i < viewer->count; i++) {
+            QueuedFrame *queued = &viewer->queue[(viewer->head + i) % FRAME_SERVER_QUEUE];
+            iov[i].iov_base = queued->frame->data + queued->offset;
+            iov[i].iov_len = CLEAR_SCREEN_LEN + queued->frame->len - queued->offset;
+        }
+
+        // MSG_NOSIGNAL => a viewer going away is an error, not a SIGPIPE
+        struct msghdr msg = {0};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = viewer->count;
+        ssize_t n = sendmsg(viewer->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+
+        while (n > 0) {
+            QueuedFrame *queued = &viewer->queue[viewer->head];
+            size_t left = CLEAR_SCREEN_LEN + queued->frame->len - queued->offset;
+            if ((size_t)n < left) {
+                queued->offset += n;
+                break;
+            }
+            n -= left;
+            frame_unref(queued->frame);
+            viewer->head = (viewer->head + 1) % FRAME_SERVER_QUEUE;
+            viewer->count--;
+        }
+    }
+    return 0;
+}
+
+static void queue_frame(FrameServer *server, Viewer *viewer, SharedFrame *frame) {
+    if (viewer->waiting_key && !frame->key) {
+        server->skipped++;
+        return;
+    }
+
+    if (frame->key) {
+        // a full repaint makes everything queued before it redundant
+        viewer_drop_queued(viewer);
+    } else if (viewer->count == FRAME_SERVER_QUEUE) {
+        // too slow => stop queueing deltas, start over at a full repaint
+        viewer_drop_queued(viewer);
+        viewer->waiting_key = 1;
+        viewer->group->key_wanted = 1;
+        server->skipped++;
+        return;
+    }
+
+    QueuedFrame *queued = &viewer->queue[(viewer->head + viewer->count) % FRAME_SERVER_QUEUE];
+    queued->frame = frame;
+    queued->start = viewer->waiting_key || frame->clear ? 0 : CLEAR_SCREEN_LEN;
+    queued->offset = queued->start;
+    frame->refs++;
+    viewer->count++;
+    viewer->waiting_key = 0;
+}
+
+static void set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// a socket file left by a server that died is removed, anything else at
+// the path is kept: a live server's socket, or a file that isn't a socket
+// (bind then fails on it)
+// 0 => the path is free to bind, -1 => another server answers there
+static int remove_stale_socket(const char *socket_path, const struct sockaddr_un *addr) {
+    struct stat st;
+    if (lstat(socket_path, &st) < 0 || !S_ISSOCK(st.st_mode)) {
+        return 0;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0) {
+        int answered = connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) == 0;
+        close(fd);
+        if (answered) {
+            fprintf(stderr, "Socket %s already in use by another server\n", socket_path);
+            return -1;
+        }
+    }
+    unlink(socket_path);
+    return 0;
+}
+
+FrameServer* frame_server_create(const char *socket_path, const EncodeOptions *options) {
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        return NULL;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    FrameServer *server = calloc(1, sizeof(FrameServer));
+    if (!server) return NULL;
+    server->options = *options;
+    server->socket_path = strdup(socket_path);
+
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (!server->socket_path || server->listen_fd < 0) {
+        perror("socket");
+        free(server->socket_path);
+        free(server);
+        return NULL;
+    }
+
+    if (remove_stale_socket(socket_path, &addr) < 0) {
+        close(server->listen_fd);
+        free(server->socket_path);
+        free(server);
+        return NULL;
+    }
+    if (bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(server->listen_fd, LISTEN_BACKLOG) < 0) {
+        fprintf(stderr, "Failed to listen on %s: %s\n", socket_path, strerror(errno));
+        close(server->listen_fd);
+        free(server->socket_path);
+        free(server);
+        return NULL;
+    }
+    set_nonblocking(server->listen_fd);
+    return server;
+}
+
+void frame_server_free(FrameServer *server) {
+    if (!server) return;
+
+    while (server->viewer_count > 0) {
+        remove_viewer(server, server->viewer_count - 1);
+    }
+    close(server->listen_fd);
+    unlink(server->socket_path);
+    free(server->socket_path);
+    free(server->viewers);
+    free(server->groups);
+    free(server->pollfds);
+    free(server);
+}
+
+// one group's frame, NULL if nothing changed or on error
+static SharedFrame* encode_group(FrameServer *server, RenderGroup *group, const unsigned char *pixels,
+                                 int width, int height, int stride) {
+    int scaled_width, scaled_height;
+    pixi_renderer_pixel_size(group->renderer, width, height, &scaled_width, &scaled_height);
+    if (group->key_wanted) {
+        pixi_renderer_repaint(group->renderer);
+    }
+
+    // a new frame size leaves the old one around its edges
+    struct iovec *bands;
+    int band_count, clear;
+    ssize_t len = pixi_renderer_encode(group->renderer, pixels, width, height, stride, scaled_width,
+                                       scaled_height, &bands, &band_count, &clear);
+    int key = group->key_wanted || clear;
+    if (len < 0 || (len == 0 && !key)) return NULL;
+
+    SharedFrame *frame = malloc(sizeof(SharedFrame) + CLEAR_SCREEN_LEN + len);
+    if (!frame) return NULL;
+
+    memcpy(frame->data, CLEAR_SCREEN, CLEAR_SCREEN_LEN);
+    char *out = frame->data + CLEAR_SCREEN_LEN;
+    for (int i = 0; i < band_count; i++) {
+        memcpy(out, bands[i].iov_base, bands[i].iov_len);
+        out += bands[i].iov_len;
+    }
+    frame->len = len;
+    frame->key = key;
+    frame->clear = clear;
+    frame->refs = 1;
+    group->key_wanted = 0;
+    server->encoded++;
+    return frame;
+}
+
+void frame_server_publish(FrameServer *server, const unsigned char *pixels, int width, int height,
+                          int stride) {
+    for (int g = 0; g < server->group_count; g++) {
+        RenderGroup *group = server->groups[g];
+        SharedFrame *frame = encode_group(server, group, pixels, width, height, stride);
+        if (!frame) continue;
+
+        for (int i = 0; i < server->viewer_count; i++) {
+            if (server->viewers[i]->group == group) {
+                queue_frame(server, server->viewers[i], frame);
+            }
+        }
+        frame_unref(frame);
+    }
+}
+
+static void accept_viewers(FrameServer *server) {
+    for (;;) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) return;
+
+        if (server->viewer_count == server->viewer_capacity) {
+            int capacity = server->viewer_capacity ? server->viewer_capacity * 2 : 8;
+            Viewer **viewers = realloc(server->viewers, capacity * sizeof(Viewer *));
+            struct pollfd *pollfds = realloc(server->pollfds, (capacity + 1) * sizeof(struct pollfd));
+            if (viewers) server->viewers = viewers;
+            if (pollfds) server->pollfds = pollfds;
+            if (!viewers || !pollfds) {
+                close(fd);
+                return;
+            }
+            server->viewer_capacity = capacity;
+        }
+
+        Viewer *viewer = calloc(1, sizeof(Viewer));
+        if (!viewer) {
+            close(fd);
+            return;
+        }
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        set_nonblocking(fd);
+        viewer->fd = fd;
+        server->viewers[server->viewer_count++] = viewer;
+    }
+}
+
+int frame_server_poll(FrameServer *server, int timeout_ms) {
+    if (!server->pollfds) {
+        server->pollfds = malloc(sizeof(struct pollfd));
+        if (!server->pollfds) return -1;
+    }
+
+    struct pollfd *fds = server->pollfds;
+    int count = server->viewer_count;
+    fds[0].fd = server->listen_fd;
+    fds[0].events = POLLIN;
+    for (int i = 0; i < count; i++) {
+        fds[i + 1].fd = server->viewers[i]->fd;
+        fds[i + 1].events = POLLIN | (server->viewers[i]->count > 0 ? POLLOUT : 0);
+    }
+
+    int ready = poll(fds, count + 1, timeout_ms);
+    if (ready < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    // backwards => removing swaps in a viewer that is already handled
+    for (int i = count - 1; i >= 0; i--) {
+        short revents = fds[i + 1].revents;
+        Viewer *viewer = server->viewers[i];
+        int ok = 1;
+        if (revents & (POLLIN | POLLHUP | POLLERR)) {
+            ok = read_hellos(server, viewer) == 0;
+        }
+        if (ok && (revents & POLLOUT)) {
+            ok = flush_viewer(viewer) == 0;
+        }
+        if (!ok) {
+            remove_viewer(server, i);
+        }
+    }
+
+    if (fds[0].revents & POLLIN) {
+        accept_viewers(server);
+    }
+    return 0;
+}
+
+void frame_server_drain(FrameServer *server, int timeout_ms) {
+    int64_t deadline = clock_now_ns() + (int64_t)timeout_ms * 1000000;
+    for (;;) {
+        int queued = 0;
+        for (int i = 0; i < server->viewer_count; i++) {
+            queued += server->viewers[i]->count;
+        }
+        int64_t left = deadline - clock_now_ns();
+        if (queued == 0 || left <= 0 || frame_server_poll(server, (int)(left / 1000000) + 1) < 0) {
+            return;
+        }
+    }
+}
+
+int frame_server_viewers(const FrameServer *server) {
+    int viewers = 0;
+    for (int i = 0; i < server->viewer_count; i++) {
+        if (server->viewers[i]->group) viewers++;
+    }
+    return viewers;
+}
+
+int frame_server_groups(const FrameServer *server) {
+    return server->group_count;
+}
+
+int frame_server_encoded(const FrameServer *server) {
+    return server->encoded;
+}
+
+int frame_server_skipped(const FrameServer *server) {
+    return server->skipped;
+}
+
+int frame_client_connect(const char *socket_path) {
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "Failed to connect to %s: %s\n", socket_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int frame_client_hello(int fd, int cols, int rows, const EncodeOptions *options) {
+    char hello[FRAME_HELLO_MAX];
+    int len = snprintf(hello, sizeof(hello), "PIXI1 %d %d %d %d %d\n", cols, rows,
+                       (int)options->color_mode, (int)options->glyph_mode, options->run_length_flags);
+    const char *p = hello;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
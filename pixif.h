@@ -0,0 +1,68 @@
+#ifndef PIXIF_H
+#define PIXIF_H
+
+#include <stddef.h>
+
+#include "pixir.h"
+
+// fan-out: one process decodes a video and encodes every frame once per
+// distinct viewer setup, any number of viewers connected over a unix
+// socket get the bytes
+// viewers sharing a grid, color mode, glyph mode and run length escapes
+// form a group with one encoder, every frame it encodes is a single
+// refcounted buffer queued to all of them
+// a viewer that falls FRAME_SERVER_QUEUE frames behind gets nothing more
+// until its group's next full repaint (requested for it) instead of an
+// ever growing backlog
+
+// frames a viewer can have queued before it is skipped ahead
+#define FRAME_SERVER_QUEUE 8
+
+// viewer => server, once after connecting and again after every resize:
+// "PIXI1 <cols> <rows> <color mode> <glyph mode> <run length flags>\n"
+// server => viewer: terminal bytes, nothing else
+#define FRAME_HELLO_MAX 64
+
+typedef struct FrameServer FrameServer;
+
+// listens on socket_path (replacing a stale socket file)
+// options: everything the viewers don't choose (delta threshold, lossy
+// colors, encode threads), delta is always on
+// NULL on error
+FrameServer* frame_server_create(const char *socket_path, const EncodeOptions *options);
+
+// closes every connection and removes the socket file
+void frame_server_free(FrameServer *server);
+
+// RGB24 pixels, rows stride bytes apart, of any size => scaled + encoded
+// once per group and queued to its viewers, nothing is written here
+void frame_server_publish(FrameServer *server, const unsigned char *pixels, int width, int height,
+                          int stride);
+
+// accept viewers, read their hellos and write queued frames, waiting up
+// to timeout_ms for any of that (-1 => until something happens)
+// 0 on success, -1 on error (the listening socket failed)
+int frame_server_poll(FrameServer *server, int timeout_ms);
+
+// keep writing until every viewer has its queued frames or timeout_ms
+// passed, before freeing the server at the end of the video
+void frame_server_drain(FrameServer *server, int timeout_ms);
+
+// viewers that said hello
+int frame_server_viewers(const FrameServer *server);
+
+// groups currently encoding, frames encoded over all of them, and frames
+// viewers missed by being skipped ahead
+int frame_server_groups(const FrameServer *server);
+int frame_server_encoded(const FrameServer *server);
+int frame_server_skipped(const FrameServer *server);
+
+// viewer side: connect to a server
+// fd on success, -1 on error
+int frame_client_connect(const char *socket_path);
+
+// viewer side: (re)announce the grid frames should be drawn for
+// 0 on success, -1 on error
+int frame_client_hello(int fd, int cols, int rows, const EncodeOptions *options);
+
+#endif
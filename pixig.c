@@ -0,0 +1,268 @@
+// deterministic synthetic media for benchmarking pixi
+// same bytes on every machine with the same libav, no sample files needed
+// usage: pixig <out_dir>, files already there are kept
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+
+#define BENCH_FPS 30
+#define BENCH_FRAMES 150
+
+typedef enum {
+    PATTERN_TESTSRC,  // bars, gradient, moving box => what real footage compresses like
+    PATTERN_NOISE     // every pixel random => worst case for every stage
+} Pattern;
+
+typedef struct {
+    const char *name;
+    Pattern pattern;
+    int width;
+    int height;
+    int video;  // 0 => single jpeg
+} BenchMedia;
+
+static const BenchMedia BENCH_MEDIA[] = {
+    {"testsrc_720p.mp4", PATTERN_TESTSRC, 1280, 720, 1},
+    {"noise_720p.mp4", PATTERN_NOISE, 1280, 720, 1},
+    {"testsrc_1080p.mp4", PATTERN_TESTSRC, 1920, 1080, 1},
+    {"testsrc_1080p.jpg", PATTERN_TESTSRC, 1920, 1080, 0},
+    {"noise_1080p.jpg", PATTERN_NOISE, 1920, 1080, 0},
+};
+
+// smpte order, 75% bars
+static const unsigned char BARS[7][3] = {
+    {191, 191, 191}, {191, 191, 0}, {0, 191, 191}, {0, 191, 0},
+    {191, 0, 191}, {191, 0, 0}, {0, 0, 191}
+};
+
+static inline uint32_t xorshift32(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// RGB24 pattern for frame n
+static void fill_pattern(unsigned char *rgb, int stride, int width, int height, Pattern pattern, int n) {
+    if (pattern == PATTERN_NOISE) {
+        uint32_t state = 2654435761u * (uint32_t)(n + 1);
+        for (int y = 0; y < height; y++) {
+            unsigned char *row = rgb + y * stride;
+            for (int x = 0; x < width * 3; x += 3) {
+                uint32_t r = xorshift32(&state);
+                row[x + 0] = r;
+                row[x + 1] = r >> 8;
+                row[x + 2] = r >> 16;
+            }
+        }
+        return;
+    }
+
+    int bars_end = height * 2 / 3;
+    int box = height / 6;
+    // box bounces around the bar area
+    int span_x = width - box, span_y = bars_end - box;
+    int bx = (n * 7) % (2 * span_x);
+    int by = (n * 5) % (2 * span_y);
+    if (bx > span_x) bx = 2 * span_x - bx;
+    if (by > span_y) by = 2 * span_y - by;
+
+    for (int y = 0; y < height; y++) {
+        unsigned char *row = rgb + y * stride;
+        for (int x = 0; x < width; x++) {
+            unsigned char *p = row + x * 3;
+            if (x >= bx && x < bx + box && y >= by && y < by + box) {
+                p[0] = p[1] = p[2] = 255;
+            } else if (y < bars_end) {
+                memcpy(p, BARS[x * 7 / width], 3);
+            } else {
+                // scrolling hue gradient
+                int t = (x + n * 4) % width;
+                p[0] = t * 255 / width;
+                p[1] = (y - bars_end) * 255 / (height - bars_end);
+                p[2] = 255 - p[0];
+            }
+        }
+    }
+}
+
+// encoded frames of enc => file (or just the packet bytes for jpeg)
+// frame NULL flushes
+static int drain_packets(AVCodecContext *enc, const AVFrame *frame, AVFormatContext *oc, AVStream *stream, FILE *raw) {
+    int ret = avcodec_send_frame(enc, frame);
+    if (ret < 0) return -1;
+
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) return -1;
+
+    while ((ret = avcodec_receive_packet(enc, packet)) >= 0) {
+        if (raw) {
+            fwrite(packet->data, 1, packet->size, raw);
+        } else {
+            av_packet_rescale_ts(packet, enc->time_base, stream->time_base);
+            packet->stream_index = stream->index;
+            av_interleaved_write_frame(oc, packet);
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+
+    return (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) ? 0 : -1;
+}
+
+static int generate(const BenchMedia *media, const char *path) {
+    enum AVCodecID codec_id = media->video ? AV_CODEC_ID_MPEG4 : AV_CODEC_ID_MJPEG;
+    enum AVPixelFormat pix_fmt = media->video ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_YUVJ420P;
+
+    const AVCodec *codec = avcodec_find_encoder(codec_id);
+    if (!codec) {
+        fprintf(stderr, "No %s encoder in this libav build\n", media->video ? "mpeg4" : "mjpeg");
+        return -1;
+    }
+
+    int ret = -1;
+    AVFormatContext *oc = NULL;
+    AVStream *stream = NULL;
+    FILE *raw = NULL;
+    AVCodecContext *enc = avcodec_alloc_context3(codec);
+    AVFrame *frame = av_frame_alloc();
+    unsigned char *rgb = malloc((size_t)media->width * media->height * 3);
+    struct SwsContext *sws = sws_getContext(media->width, media->height, AV_PIX_FMT_RGB24,
+                                            media->width, media->height, pix_fmt,
+                                            SWS_BILINEAR, NULL, NULL, NULL);
+    if (!enc || !frame || !rgb || !sws) {
+        fprintf(stderr, "Could not allocate encoder state\n");
+        goto cleanup;
+    }
+
+    // single threaded + bitexact => reproducible output
+    enc->width = media->width;
+    enc->height = media->height;
+    enc->pix_fmt = pix_fmt;
+    enc->time_base = (AVRational){1, BENCH_FPS};
+    enc->framerate = (AVRational){BENCH_FPS, 1};
+    enc->gop_size = BENCH_FPS;
+    enc->max_b_frames = 0;
+    enc->bit_rate = (int64_t)media->width * media->height * 4;
+    enc->thread_count = 1;
+    enc->flags |= AV_CODEC_FLAG_BITEXACT;
+
+    if (media->video) {
+        if (avformat_alloc_output_context2(&oc, NULL, NULL, path) < 0 || !oc) {
+            fprintf(stderr, "Could not create container for %s\n", path);
+            goto cleanup;
+        }
+        oc->flags |= AVFMT_FLAG_BITEXACT;
+        if (oc->oformat->flags & AVFMT_GLOBALHEADER) {
+            enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+    }
+
+    if (avcodec_open2(enc, codec, NULL) < 0) {
+        fprintf(stderr, "Could not open encoder\n");
+        goto cleanup;
+    }
+
+    if (media->video) {
+        stream = avformat_new_stream(oc, NULL);
+        if (!stream || avcodec_parameters_from_context(stream->codecpar, enc) < 0) {
+            fprintf(stderr, "Could not create stream\n");
+            goto cleanup;
+        }
+        stream->time_base = enc->time_base;
+
+        if (avio_open(&oc->pb, path, AVIO_FLAG_WRITE) < 0 || avformat_write_header(oc, NULL) < 0) {
+            fprintf(stderr, "Could not write %s\n", path);
+            goto cleanup;
+        }
+    } else {
+        raw = fopen(path, "wb");
+        if (!raw) {
+            fprintf(stderr, "Could not write %s\n", path);
+            goto cleanup;
+        }
+    }
+
+    frame->format = pix_fmt;
+    frame->width = media->width;
+    frame->height = media->height;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        fprintf(stderr, "Could not allocate frame\n");
+        goto cleanup;
+    }
+
+    int frames = media->video ? BENCH_FRAMES : 1;
+    for (int n = 0; n < frames; n++) {
+        if (av_frame_make_writable(frame) < 0) goto cleanup;
+
+        fill_pattern(rgb, media->width * 3, media->width, media->height, media->pattern, n);
+
+        const uint8_t *src[4] = {rgb, NULL, NULL, NULL};
+        int src_stride[4] = {media->width * 3, 0, 0, 0};
+        sws_scale(sws, src, src_stride, 0, media->height, frame->data, frame->linesize);
+        frame->pts = n;
+
+        if (drain_packets(enc, frame, oc, stream, raw) < 0) {
+            fprintf(stderr, "Encoding failed\n");
+            goto cleanup;
+        }
+    }
+
+    if (drain_packets(enc, NULL, oc, stream, raw) < 0) {
+        fprintf(stderr, "Encoding failed\n");
+        goto cleanup;
+    }
+
+    if (oc) {
+        av_write_trailer(oc);
+    }
+    ret = 0;
+
+cleanup:
+    if (raw) fclose(raw);
+    if (oc) {
+        if (oc->pb) avio_closep(&oc->pb);
+        avformat_free_context(oc);
+    }
+    if (ret < 0) unlink(path);
+    sws_freeContext(sws);
+    free(rgb);
+    av_frame_free(&frame);
+    avcodec_free_context(&enc);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <out_dir>\n", argv[0]);
+        return 1;
+    }
+
+    const char *dir = argv[1];
+    mkdir(dir, 0755);
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(BENCH_MEDIA) / sizeof(BENCH_MEDIA[0]); i++) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, BENCH_MEDIA[i].name);
+
+        if (access(path, F_OK) == 0) {
+            continue;
+        }
+
+        printf("Generating %s\n", path);
+        if (generate(&BENCH_MEDIA[i], path) < 0) {
+            failed = 1;
+        }
+    }
+
+    return failed;
+}
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+
+#include "pixii.h"
+
+// packets of the image stream => first decoded frame
+// 0 on success, -1 on error
+static int decode_first_frame(AVFormatContext *format_ctx, AVCodecContext *codec_ctx,
+                              int stream_index, AVFrame *frame) {
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) return -1;
+
+    int ret;
+    int draining = 0;
+    for (;;) {
+        ret = avcodec_receive_frame(codec_ctx, frame);
+        if (ret >= 0) break;
+        if (ret != AVERROR(EAGAIN) || draining) break;
+
+        ret = av_read_frame(format_ctx, packet);
+        if (ret < 0) {
+            // single packet images only come out once the codec is flushed
+            avcodec_send_packet(codec_ctx, NULL);
+            draining = 1;
+            continue;
+        }
+
+        if (packet->stream_index == stream_index) {
+            ret = avcodec_send_packet(codec_ctx, packet);
+            if (ret < 0 && ret != AVERROR(EAGAIN)) {
+                av_packet_unref(packet);
+                break;
+            }
+        }
+        av_packet_unref(packet);
+    }
+
+    av_packet_free(&packet);
+    return ret >= 0 ? 0 : -1;
+}
+
+ImageDecoder* image_decoder_open(const char *path) {
+    AVFormatContext *format_ctx = NULL;
+    AVCodecContext *codec_ctx = NULL;
+    ImageDecoder *decoder = NULL;
+
+    if (avformat_open_input(&format_ctx, path, NULL, NULL) < 0) {
+        fprintf(stderr, "Could not open image file: %s\n", path);
+        return NULL;
+    }
+
+    // image demuxers know the codec from the probe, find_stream_info would
+    // decode the whole picture once more just to read its size
+    const AVCodec *codec = NULL;
+    int stream_index = av_find_best_stream(format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (stream_index < 0 && avformat_find_stream_info(format_ctx, NULL) >= 0) {
+        stream_index = av_find_best_stream(format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    }
+    if (stream_index < 0 || !codec) {
+        fprintf(stderr, "No decodable image in %s\n", path);
+        goto fail;
+    }
+
+    codec_ctx = avcodec_alloc_context3(codec);
+    if (!codec_ctx ||
+        avcodec_parameters_to_context(codec_ctx, format_ctx->streams[stream_index]->codecpar) < 0) {
+        fprintf(stderr, "Could not set up image codec\n");
+        goto fail;
+    }
+
+    // one frame => frame threads only add latency, slices still help
+    codec_ctx->thread_count = 0;
+    codec_ctx->thread_type = FF_THREAD_SLICE;
+
+    if (avcodec_open2(codec_ctx, codec, NULL) < 0) {
+        fprintf(stderr, "Could not open image codec\n");
+        goto fail;
+    }
+
+    decoder = calloc(1, sizeof(ImageDecoder));
+    if (decoder) decoder->frame = av_frame_alloc();
+    if (!decoder || !decoder->frame) {
+        fprintf(stderr, "Failed to allocate image decoder\n");
+        goto fail;
+    }
+
+    if (decode_first_frame(format_ctx, codec_ctx, stream_index, decoder->frame) < 0 ||
+        decoder->frame->width <= 0 || decoder->frame->height <= 0) {
+        fprintf(stderr, "Could not decode image: %s\n", path);
+        goto fail;
+    }
+
+    decoder->width = decoder->frame->width;
+    decoder->height = decoder->frame->height;
+
+    avcodec_free_context(&codec_ctx);
+    avformat_close_input(&format_ctx);
+    return decoder;
+
+fail:
+    image_decoder_close(decoder);
+    avcodec_free_context(&codec_ctx);
+    avformat_close_input(&format_ctx);
+    return NULL;
+}
+
+int image_decoder_scale(ImageDecoder *decoder, int out_width, int out_height,
+                        unsigned char *dst, int dst_stride) {
+    if (!decoder || out_width <= 0 || out_height <= 0) return -1;
+
+    enum AVPixelFormat src_fmt = decoder->frame->format;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(src_fmt);
+    int has_alpha = desc && (desc->flags & AV_PIX_FMT_FLAG_ALPHA);
+
+    // area averaging when shrinking, bilinear otherwise
+    int flags = (out_width < decoder->width || out_height < decoder->height) ? SWS_AREA : SWS_BILINEAR;
+
+    struct SwsContext *sws_ctx = sws_getContext(
+        decoder->width, decoder->height, src_fmt,
+        out_width, out_height, has_alpha ? AV_PIX_FMT_RGBA : AV_PIX_FMT_RGB24,
+        flags, NULL, NULL, NULL
+    );
+    if (!sws_ctx) {
+        fprintf(stderr, "Could not create image scaler\n");
+        return -1;
+    }
+
+    // swscale's packed rgb simd stores can run past a row's end => it
+    // writes into rows padded to 32 bytes plus a spare row, never into dst
+    // alpha is flattened at output size, where it is cheap
+    int bytes_per_pixel = has_alpha ? 4 : 3;
+    int scaled_stride = (out_width * bytes_per_pixel + 31) & ~31;
+    unsigned char *scaled = malloc((size_t)scaled_stride * (out_height + 1));
+    if (!scaled) {
+        fprintf(stderr, "Failed to allocate image buffer\n");
+        sws_freeContext(sws_ctx);
+        return -1;
+    }
+
+    uint8_t *dst_data[4] = {scaled, NULL, NULL, NULL};
+    int dst_linesize[4] = {scaled_stride, 0, 0, 0};
+    sws_scale(sws_ctx, (const uint8_t * const*)decoder->frame->data, decoder->frame->linesize,
+              0, decoder->height, dst_data, dst_linesize);
+    sws_freeContext(sws_ctx);
+
+    for (int y = 0; y < out_height; y++) {
+        const unsigned char *src = scaled + (size_t)y * scaled_stride;
+        unsigned char *out = dst + (size_t)y * dst_stride;
+        if (!has_alpha) {
+            memcpy(out, src, (size_t)out_width * 3);
+            continue;
+        }
+        for (int x = 0; x < out_width; x++, src += 4, out += 3) {
+            int a = src[3];
+            // x * a / 255 rounded, without the divide
+            for (int c = 0; c < 3; c++) {
+                int v = src[c] * a + 128;
+                out[c] = (v + (v >> 8)) >> 8;
+            }
+        }
+    }
+
+    free(scaled);
+    return 0;
+}
+
+void image_decoder_close(ImageDecoder *decoder) {
+    if (!decoder) return;
+
+    if (decoder->frame) {
+        av_frame_free(&decoder->frame);
+    }
+    free(decoder);
+}
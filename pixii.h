@@ -0,0 +1,28 @@
+#ifndef PIXII_H
+#define PIXII_H
+
+#include <libavutil/frame.h>
+
+// still image decoded by libav, any format it has a decoder for
+// (png, gif, bmp, tiff, webp, jpeg, ...), animated ones stop at frame one
+// kept in the codec's own pixel format until image_decoder_scale, so the
+// color conversion and the downscale are a single swscale pass
+typedef struct {
+    AVFrame *frame;
+    int width;
+    int height;
+} ImageDecoder;
+
+// decode the first frame of path
+// NULL on error
+ImageDecoder* image_decoder_open(const char *path);
+
+// scale + convert to RGB24 out_width x out_height into dst
+// transparent pixels are composited over black
+// 0 on success, -1 on error
+int image_decoder_scale(ImageDecoder *decoder, int out_width, int out_height,
+                        unsigned char *dst, int dst_stride);
+
+void image_decoder_close(ImageDecoder *decoder);
+
+#endif
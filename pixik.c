@@ -0,0 +1,241 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "pixik.h"
+
+// the protocol caps a chunk at 4096 base64 bytes = 3072 payload bytes
+#define CHUNK_BYTES 3072
+#define CHUNK_BASE64 4096
+
+// worst case for "\033[H" + the first command's keys and terminator
+#define COMMAND_HEADER 160
+
+// "\033_Gm=1;" ... "\033\\"
+#define CHUNK_OVERHEAD 11
+
+#define SHM_NAME_MAX 48
+
+struct KittyEncoder {
+    KittyTransfer transfer;
+    z_stream zs;
+    unsigned char *zbuf;
+    size_t zbuf_capacity;
+    int segments;
+    int next;  // segment the next frame goes to
+};
+
+static const char base64_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static size_t base64_encode(const unsigned char *src, size_t len, char *dst) {
+    char *p = dst;
+    size_t i = 0;
+    for (; i + 2 < len; i += 3) {
+        unsigned int v = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+        *p++ = base64_chars[v >> 18];
+        *p++ = base64_chars[(v >> 12) & 63];
+        *p++ = base64_chars[(v >> 6) & 63];
+        *p++ = base64_chars[v & 63];
+    }
+    if (i < len) {
+        unsigned int v = src[i] << 16;
+        if (i + 1 < len) v |= src[i + 1] << 8;
+        *p++ = base64_chars[v >> 18];
+        *p++ = base64_chars[(v >> 12) & 63];
+        *p++ = i + 1 < len ? base64_chars[(v >> 6) & 63] : '=';
+        *p++ = '=';
+    }
+    return p - dst;
+}
+
+// names are per process, the terminal reads them from another one
+static void shm_name(int segment, char *name) {
+    snprintf(name, SHM_NAME_MAX, "/pixi-%d-%d", (int)getpid(), segment);
+}
+
+// one frame into the next segment in rotation
+// the terminal unlinks a segment once it has read it, so the name is free
+// again unless that frame was never shown (dropped, or not a kitty
+// terminal after all) => stale objects are replaced
+// 0 on success, -1 on error
+static int write_segment(KittyEncoder *encoder, const unsigned char *pixels, int width, int height,
+                         int stride, char *name) {
+    shm_name(encoder->next, name);
+    size_t row_bytes = (size_t)width * 3;
+    size_t size = row_bytes * height;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        shm_unlink(name);
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    }
+    if (fd < 0) return -1;
+
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        map = mmap(NULL, size, PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        shm_unlink(name);
+        return -1;
+    }
+
+    if (stride == (int)row_bytes) {
+        memcpy(map, pixels, size);
+    } else {
+        for (int y = 0; y < height; y++) {
+            memcpy((unsigned char *)map + y * row_bytes, pixels + (size_t)y * stride, row_bytes);
+        }
+    }
+    munmap(map, size);
+
+    encoder->next = (encoder->next + 1) % encoder->segments;
+    return 0;
+}
+
+// rows deflated into zbuf, returns compressed bytes, 0 on error
+static size_t compress_frame(KittyEncoder *encoder, const unsigned char *pixels, int width, int height,
+                             int stride) {
+    size_t row_bytes = (size_t)width * 3;
+    size_t bound = deflateBound(&encoder->zs, row_bytes * height);
+    if (bound > encoder->zbuf_capacity) {
+        unsigned char *grown = realloc(encoder->zbuf, bound);
+        if (!grown) return 0;
+        encoder->zbuf = grown;
+        encoder->zbuf_capacity = bound;
+    }
+
+    if (deflateReset(&encoder->zs) != Z_OK) return 0;
+    encoder->zs.next_out = encoder->zbuf;
+    encoder->zs.avail_out = encoder->zbuf_capacity;
+
+    // fed row by row, padded strides never get copied
+    for (int y = 0; y < height; y++) {
+        encoder->zs.next_in = (unsigned char *)pixels + (size_t)y * stride;
+        encoder->zs.avail_in = row_bytes;
+        int ret = deflate(&encoder->zs, y == height - 1 ? Z_FINISH : Z_NO_FLUSH);
+        if (ret == Z_STREAM_ERROR || (y == height - 1 && ret != Z_STREAM_END)) return 0;
+    }
+    return encoder->zs.total_out;
+}
+
+KittyEncoder* kitty_encoder_create(KittyTransfer transfer, int segments) {
+    KittyEncoder *encoder = calloc(1, sizeof(KittyEncoder));
+    if (!encoder) return NULL;
+
+    encoder->transfer = transfer;
+    encoder->segments = segments < 2 ? 2 : segments;
+
+    // level 1: the terminal pays for inflate, we pay for deflate every frame
+    if (deflateInit(&encoder->zs, 1) != Z_OK) {
+        fprintf(stderr, "Failed to init zlib\n");
+        free(encoder);
+        return NULL;
+    }
+
+    if (transfer == KITTY_TRANSFER_SHM) {
+        // probe once so a missing /dev/shm reads as "use direct" up front
+        char name[SHM_NAME_MAX];
+        shm_name(encoder->segments, name);
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            fprintf(stderr, "No shared memory (%s), sending pixels through the terminal\n", strerror(errno));
+            encoder->transfer = KITTY_TRANSFER_DIRECT;
+        } else {
+            close(fd);
+            shm_unlink(name);
+        }
+    }
+    return encoder;
+}
+
+KittyTransfer kitty_encoder_transfer(const KittyEncoder *encoder) {
+    return encoder->transfer;
+}
+
+size_t kitty_frame_buffer_size(int width, int height) {
+    // zlib's worst case is a few bytes per 16k block over the input
+    size_t raw = (size_t)width * height * 3;
+    size_t compressed = raw + raw / 1000 + (raw >> 14) * 5 + 64;
+    size_t chunks = compressed / CHUNK_BYTES + 1;
+    return COMMAND_HEADER + chunks * (CHUNK_BASE64 + CHUNK_OVERHEAD);
+}
+
+size_t kitty_encode_frame(KittyEncoder *encoder, const unsigned char *pixels, int width, int height,
+                          int stride, int cols, int rows, char *buf) {
+    if (width <= 0 || height <= 0) return 0;
+
+    // a=T transmit + show, q=2 no replies (they would land on our stdin),
+    // C=1 leave the cursor where it is
+    char *p = buf;
+    p += sprintf(p, "\033[H\033_Ga=T,f=24,s=%d,v=%d,i=%d,p=1,c=%d,r=%d,C=1,q=2",
+                 width, height, KITTY_IMAGE_ID, cols, rows);
+
+    char name[SHM_NAME_MAX];
+    if (encoder->transfer == KITTY_TRANSFER_SHM &&
+        write_segment(encoder, pixels, width, height, stride, name) == 0) {
+        p += sprintf(p, ",t=s,S=%zu;", (size_t)width * height * 3);
+        p += base64_encode((const unsigned char *)name, strlen(name), p);
+        memcpy(p, "\033\\", 2);
+        return p + 2 - buf;
+    }
+
+    size_t compressed = compress_frame(encoder, pixels, width, height, stride);
+    if (compressed == 0) {
+        fprintf(stderr, "Failed to compress frame\n");
+        return 0;
+    }
+
+    // first chunk carries the keys, the rest only m=, m=0 ends the image
+    p += sprintf(p, ",t=d,o=z");
+    for (size_t offset = 0; offset < compressed; offset += CHUNK_BYTES) {
+        size_t len = compressed - offset < CHUNK_BYTES ? compressed - offset : CHUNK_BYTES;
+        int more = offset + len < compressed;
+        if (offset == 0) {
+            p += sprintf(p, ",m=%d;", more);
+        } else {
+            p += sprintf(p, "\033_Gm=%d;", more);
+        }
+        p += base64_encode(encoder->zbuf + offset, len, p);
+        memcpy(p, "\033\\", 2);
+        p += 2;
+    }
+    return p - buf;
+}
+
+void kitty_encoder_free(KittyEncoder *encoder) {
+    if (!encoder) return;
+
+    if (encoder->transfer == KITTY_TRANSFER_SHM) {
+        char name[SHM_NAME_MAX];
+        for (int i = 0; i < encoder->segments; i++) {
+            shm_name(i, name);
+            shm_unlink(name);
+        }
+    }
+    deflateEnd(&encoder->zs);
+    free(encoder->zbuf);
+    free(encoder);
+}
+
+int kitty_cell_pixels(int fd, int *width, int *height) {
+    struct winsize ws;
+    if (ioctl(fd, TIOCGWINSZ, &ws) < 0 || ws.ws_col == 0 || ws.ws_row == 0 ||
+        ws.ws_xpixel == 0 || ws.ws_ypixel == 0) {
+        return -1;
+    }
+    *width = ws.ws_xpixel / ws.ws_col;
+    *height = ws.ws_ypixel / ws.ws_row;
+    return (*width > 0 && *height > 0) ? 0 : -1;
+}
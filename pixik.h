@@ -0,0 +1,51 @@
+#ifndef PIXIK_H
+#define PIXIK_H
+
+#include <stddef.h>
+
+// kitty graphics protocol output: every frame is one rgb image placed at
+// the top left instead of a grid of text cells
+// shm => pixels go into a posix shared memory object, only its name goes
+//        through the pty (t=s), the terminal unlinks it once read
+// direct => pixels are zlib compressed and base64 encoded into the escape
+//           stream, 4096 bytes per chunk (t=d, o=z)
+typedef enum {
+    KITTY_TRANSFER_SHM,
+    KITTY_TRANSFER_DIRECT
+} KittyTransfer;
+
+// every frame reuses this image / placement id => the terminal replaces
+// the previous frame instead of stacking images
+#define KITTY_IMAGE_ID 7031
+
+// deletes the image and frees its memory in the terminal
+#define KITTY_DELETE_IMAGE "\033_Ga=d,d=I,i=7031,q=2\033\\"
+
+typedef struct KittyEncoder KittyEncoder;
+
+// segments: shm names in rotation, one per frame that can be queued ahead
+// of the terminal plus the one it is reading, at least 2
+// shm that can't be created falls back to direct
+// NULL on error
+KittyEncoder* kitty_encoder_create(KittyTransfer transfer, int segments);
+
+KittyTransfer kitty_encoder_transfer(const KittyEncoder *encoder);
+
+// worst case bytes kitty_encode_frame writes for width x height pixels
+size_t kitty_frame_buffer_size(int width, int height);
+
+// "\033[H" + the graphics command(s) showing width x height RGB24 pixels
+// (rows stride bytes apart) scaled to cols x rows cells, cursor unmoved
+// one encoder per thread, frames are encoded in the order they are shown
+// returns bytes written to buf, 0 on error
+size_t kitty_encode_frame(KittyEncoder *encoder, const unsigned char *pixels, int width, int height,
+                          int stride, int cols, int rows, char *buf);
+
+// also removes shm objects the terminal never read
+void kitty_encoder_free(KittyEncoder *encoder);
+
+// size of one character cell in pixels as the terminal reports it
+// 0 on success, -1 if it doesn't (not a terminal, or no pixel size)
+int kitty_cell_pixels(int fd, int *width, int *height);
+
+#endif
@@ -0,0 +1,327 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "pixik.h"
+
+// fake terminal for the kitty backend: reads what kitty_encode_frame writes
+// the way a terminal would, rebuilds the image from it and compares that
+// with the pixels that went in
+// exit status 0 => every frame checked out
+
+// one "\033_G<keys>;<payload>\033\\" command
+typedef struct {
+    const char *keys;
+    size_t keys_len;
+    const char *payload;
+    size_t payload_len;
+} Command;
+
+// parses the command at p, returns the byte after it, NULL if malformed
+static const char* next_command(const char *p, const char *end, Command *cmd) {
+    if (end - p < 3 || memcmp(p, "\033_G", 3) != 0) return NULL;
+    p += 3;
+
+    const char *stop = p;
+    while (stop + 1 < end && !(stop[0] == '\033' && stop[1] == '\\')) stop++;
+    if (stop + 1 >= end) return NULL;
+
+    const char *semi = memchr(p, ';', stop - p);
+    cmd->keys = p;
+    cmd->keys_len = (semi ? semi : stop) - p;
+    cmd->payload = semi ? semi + 1 : stop;
+    cmd->payload_len = stop - cmd->payload;
+    return stop + 2;
+}
+
+// value of key=value in the command's keys, 0 if found
+static int key_value(const Command *cmd, const char *key, char *value, size_t len) {
+    size_t key_len = strlen(key);
+    const char *p = cmd->keys;
+    const char *end = cmd->keys + cmd->keys_len;
+    while (p < end) {
+        const char *comma = memchr(p, ',', end - p);
+        if (!comma) comma = end;
+        if ((size_t)(comma - p) > key_len && memcmp(p, key, key_len) == 0 && p[key_len] == '=') {
+            size_t n = comma - p - key_len - 1;
+            if (n >= len) return -1;
+            memcpy(value, p + key_len + 1, n);
+            value[n] = '\0';
+            return 0;
+        }
+        p = comma + 1;
+    }
+    return -1;
+}
+
+static int expect_key(const Command *cmd, const char *key, const char *want) {
+    char value[64];
+    if (key_value(cmd, key, value, sizeof(value)) < 0) {
+        fprintf(stderr, "missing key %s= in %.*s\n", key, (int)cmd->keys_len, cmd->keys);
+        return -1;
+    }
+    if (strcmp(value, want) != 0) {
+        fprintf(stderr, "%s=%s, expected %s\n", key, value, want);
+        return -1;
+    }
+    return 0;
+}
+
+static int expect_int(const Command *cmd, const char *key, long want) {
+    char text[32];
+    snprintf(text, sizeof(text), "%ld", want);
+    return expect_key(cmd, key, text);
+}
+
+static int base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+// decoded bytes into dst, returns how many, -1 if malformed
+static long base64_decode(const char *src, size_t len, unsigned char *dst) {
+    if (len % 4 != 0) return -1;
+    long n = 0;
+    for (size_t i = 0; i < len; i += 4) {
+        int pad = (src[i + 3] == '=') + (src[i + 2] == '=');
+        if (pad && i + 4 != len) return -1;
+        unsigned int v = 0;
+        for (int k = 0; k < 4; k++) {
+            int d = k >= 4 - pad ? 0 : base64_value(src[i + k]);
+            if (d < 0) return -1;
+            v = v << 6 | d;
+        }
+        dst[n++] = v >> 16;
+        if (pad < 2) dst[n++] = (v >> 8) & 255;
+        if (pad < 1) dst[n++] = v & 255;
+    }
+    return n;
+}
+
+static int same_pixels(const unsigned char *image, const unsigned char *pixels, int width, int height,
+                       int stride) {
+    size_t row_bytes = (size_t)width * 3;
+    for (int y = 0; y < height; y++) {
+        if (memcmp(image + y * row_bytes, pixels + (size_t)y * stride, row_bytes) != 0) {
+            fprintf(stderr, "pixels differ in row %d\n", y);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// t=s: the payload names a shm object holding the tight rgb rows, the
+// terminal unlinks it once read
+static int read_shm(const Command *cmd, const unsigned char *pixels, int width, int height, int stride) {
+    size_t size = (size_t)width * height * 3;
+    if (expect_int(cmd, "S", (long)size) < 0) return -1;
+
+    char name[128];
+    long n = cmd->payload_len < 160 ? base64_decode(cmd->payload, cmd->payload_len, (unsigned char *)name) : -1;
+    if (n <= 0) {
+        fprintf(stderr, "bad shm name payload\n");
+        return -1;
+    }
+    name[n] = '\0';
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "shm object %s doesn't exist\n", name);
+        return -1;
+    }
+    shm_unlink(name);
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size == size) {
+        map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "shm object %s isn't %zu bytes\n", name, size);
+        return -1;
+    }
+    int same = same_pixels(map, pixels, width, height, stride);
+    munmap(map, size);
+    return same ? 0 : -1;
+}
+
+// t=d,o=z: base64 of the deflated rows split over m=1 chunks up to the
+// m=0 one, later chunks carry nothing but m=
+// the terminal joins the chunks before decoding => padding only at the end
+// *next: the byte after the last chunk
+static int read_direct(const Command *first, const char *p, const char *end, const unsigned char *pixels,
+                       int width, int height, int stride, const char **next) {
+    if (expect_key(first, "o", "z") < 0) return -1;
+
+    size_t size = (size_t)width * height * 3;
+    char *text = malloc(end - p + first->payload_len);
+    unsigned char *compressed = malloc(end - p + first->payload_len);
+    unsigned char *image = malloc(size);
+    if (!text || !compressed || !image) {
+        free(text);
+        free(compressed);
+        free(image);
+        return -1;
+    }
+
+    int ok = 1;
+    size_t text_len = 0;
+    Command cmd = *first;
+    for (int chunk = 0;; chunk++) {
+        char more[8];
+        if (key_value(&cmd, "m", more, sizeof(more)) < 0 || (strcmp(more, "0") && strcmp(more, "1"))) {
+            fprintf(stderr, "chunk %d has no m=0/1\n", chunk);
+            ok = 0;
+            break;
+        }
+        if (chunk > 0 && cmd.keys_len != 3) {
+            fprintf(stderr, "chunk %d carries keys besides m=: %.*s\n", chunk, (int)cmd.keys_len, cmd.keys);
+            ok = 0;
+            break;
+        }
+        if (cmd.payload_len > 4096) {
+            fprintf(stderr, "chunk %d is %zu base64 bytes, the limit is 4096\n", chunk, cmd.payload_len);
+            ok = 0;
+            break;
+        }
+        memcpy(text + text_len, cmd.payload, cmd.payload_len);
+        text_len += cmd.payload_len;
+        if (more[0] == '0') break;
+
+        p = next_command(p, end, &cmd);
+        if (!p) {
+            fprintf(stderr, "m=1 but no chunk follows\n");
+            ok = 0;
+            break;
+        }
+    }
+    *next = p;
+
+    long compressed_len = ok ? base64_decode(text, text_len, compressed) : -1;
+    if (ok && compressed_len < 0) {
+        fprintf(stderr, "joined chunks aren't base64\n");
+        ok = 0;
+    }
+    if (ok) {
+        uLongf image_len = size;
+        if (uncompress(image, &image_len, compressed, compressed_len) != Z_OK || image_len != size) {
+            fprintf(stderr, "payload doesn't inflate to %zu bytes\n", size);
+            ok = 0;
+        } else {
+            ok = same_pixels(image, pixels, width, height, stride);
+        }
+    }
+    free(text);
+    free(compressed);
+    free(image);
+    return ok ? 0 : -1;
+}
+
+// one frame through the encoder and the fake terminal
+static int check_frame(KittyEncoder *encoder, const unsigned char *pixels, int width, int height, int stride,
+                       int cols, int rows) {
+    size_t capacity = kitty_frame_buffer_size(width, height);
+    char *buf = malloc(capacity);
+    if (!buf) return -1;
+
+    size_t len = kitty_encode_frame(encoder, pixels, width, height, stride, cols, rows, buf);
+    const char *end = buf + len;
+    const char *p = buf;
+    Command cmd;
+    int ok = 0;
+
+    if (len == 0 || len > capacity) {
+        fprintf(stderr, "encoded %zu bytes into a %zu byte buffer\n", len, capacity);
+    } else if (memcmp(buf, "\033[H", 3) != 0) {
+        fprintf(stderr, "frame doesn't start at the top left\n");
+    } else if (!(p = next_command(buf + 3, end, &cmd))) {
+        fprintf(stderr, "no graphics command\n");
+    } else if (expect_key(&cmd, "a", "T") == 0 && expect_key(&cmd, "f", "24") == 0 &&
+               expect_int(&cmd, "s", width) == 0 && expect_int(&cmd, "v", height) == 0 &&
+               expect_int(&cmd, "i", KITTY_IMAGE_ID) == 0 && expect_key(&cmd, "q", "2") == 0 &&
+               expect_int(&cmd, "c", cols) == 0 && expect_int(&cmd, "r", rows) == 0) {
+        if (kitty_encoder_transfer(encoder) == KITTY_TRANSFER_SHM) {
+            ok = expect_key(&cmd, "t", "s") == 0 && read_shm(&cmd, pixels, width, height, stride) == 0;
+        } else {
+            ok = expect_key(&cmd, "t", "d") == 0 &&
+                 read_direct(&cmd, p, end, pixels, width, height, stride, &p) == 0;
+        }
+        if (ok && p != end) {
+            fprintf(stderr, "%zu bytes after the image\n", (size_t)(end - p));
+            ok = 0;
+        }
+    }
+    free(buf);
+    return ok ? 0 : -1;
+}
+
+// smooth => deflates well, noisy => stored blocks and many chunks
+static void fill(unsigned char *pixels, int width, int height, int stride, int frame, int noisy) {
+    unsigned int seed = 2463534242u + frame;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < stride; x++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            // padding gets junk a lazy copy would leak into the image
+            pixels[(size_t)y * stride + x] = noisy || x >= width * 3 ? seed : (x + y * 2 + frame * 9) & 255;
+        }
+    }
+}
+
+int main(void) {
+    static const struct {
+        int width, height, padding, noisy;
+    } sizes[] = {
+        {1, 1, 0, 0},
+        {37, 23, 13, 0},    // odd size, padded stride
+        {64, 48, 0, 1},
+        {320, 200, 64, 1},  // several chunks, padded stride
+        {640, 360, 0, 0},
+    };
+    static const KittyTransfer transfers[] = {KITTY_TRANSFER_SHM, KITTY_TRANSFER_DIRECT};
+    int frames = 0, failed = 0;
+
+    for (size_t t = 0; t < sizeof(transfers) / sizeof(transfers[0]); t++) {
+        KittyEncoder *encoder = kitty_encoder_create(transfers[t], 2);
+        if (!encoder) return 1;
+        if (kitty_encoder_transfer(encoder) != transfers[t]) {
+            fprintf(stderr, "no shared memory here, shm falls back to direct\n");
+        }
+
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            int width = sizes[s].width, height = sizes[s].height;
+            int stride = width * 3 + sizes[s].padding;
+            unsigned char *pixels = malloc((size_t)stride * height);
+            if (!pixels) return 1;
+
+            // more frames than shm segments => names get reused
+            for (int frame = 0; frame < 3; frame++) {
+                fill(pixels, width, height, stride, frame, sizes[s].noisy);
+                if (check_frame(encoder, pixels, width, height, stride, width / 8 + 1, height / 16 + 1) < 0) {
+                    fprintf(stderr, "%s %dx%d stride %d frame %d failed\n",
+                            transfers[t] == KITTY_TRANSFER_SHM ? "shm" : "direct", width, height, stride, frame);
+                    failed++;
+                }
+                frames++;
+            }
+            free(pixels);
+        }
+        kitty_encoder_free(encoder);
+    }
+
+    printf("kitty: %d of %d frames reproduced\n", frames - failed, frames);
+    return failed ? 1 : 0;
+}
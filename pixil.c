@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "pixil.h"
+#include "pixis.h"
+
+// posix minimum is 16, every system pixi targets allows 1024
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+typedef enum {
+    OUTPUT_MEMORY,
+    OUTPUT_FD,
+    OUTPUT_CALLBACK
+} OutputKind;
+
+struct PixiRenderer {
+    int cols;
+    int rows;
+    FrameEncoder *encoder;
+
+    // scaler for the last source size, NULL => sources arrive at grid size
+    Scaler *scaler;
+    unsigned char *pixels;  // scaled frame
+    size_t pixels_capacity;
+
+    // drawn size of the last frame, 0 => clear before the next one
+    int drawn_width;
+    int drawn_height;
+
+    // CLEAR_SCREEN_LEN bytes of room, then the encoder's bands
+    char *buffer;
+    size_t buffer_capacity;
+    struct iovec *bands;  // [0] is the clear, encoded bands after it
+    int band_capacity;
+    size_t output_len;    // memory output, from buffer
+
+    OutputKind output;
+    int fd;
+    PixiWriteFn write;
+    void *user;
+};
+
+PixiRenderer* pixi_renderer_create(int cols, int rows, const EncodeOptions *options) {
+    if (cols < 1 || rows < 1) {
+        fprintf(stderr, "Invalid grid %dx%d\n", cols, rows);
+        return NULL;
+    }
+
+    PixiRenderer *renderer = calloc(1, sizeof(PixiRenderer));
+    if (!renderer) return NULL;
+
+    renderer->cols = cols;
+    renderer->rows = rows;
+    renderer->output = OUTPUT_MEMORY;
+    renderer->fd = -1;
+    renderer->encoder = frame_encoder_create(options);
+    if (!renderer->encoder) {
+        free(renderer);
+        return NULL;
+    }
+    return renderer;
+}
+
+void pixi_renderer_free(PixiRenderer *renderer) {
+    if (!renderer) return;
+
+    frame_encoder_free(renderer->encoder);
+    scaler_free(renderer->scaler);
+    free(renderer->pixels);
+    free(renderer->buffer);
+    free(renderer->bands);
+    free(renderer);
+}
+
+void pixi_renderer_output_fd(PixiRenderer *renderer, int fd) {
+    renderer->output = OUTPUT_FD;
+    renderer->fd = fd;
+}
+
+void pixi_renderer_output_callback(PixiRenderer *renderer, PixiWriteFn write, void *user) {
+    renderer->output = OUTPUT_CALLBACK;
+    renderer->write = write;
+    renderer->user = user;
+}
+
+void pixi_renderer_output_memory(PixiRenderer *renderer) {
+    renderer->output = OUTPUT_MEMORY;
+}
+
+int pixi_renderer_resize(PixiRenderer *renderer, int cols, int rows) {
+    if (cols < 1 || rows < 1) return -1;
+
+    renderer->cols = cols;
+    renderer->rows = rows;
+    renderer->drawn_width = 0;
+    renderer->drawn_height = 0;
+    frame_encoder_reset_delta(renderer->encoder);
+    return 0;
+}
+
+void pixi_renderer_repaint(PixiRenderer *renderer) {
+    frame_encoder_reset_delta(renderer->encoder);
+}
+
+void pixi_renderer_set_origin(PixiRenderer *renderer, int row, int col) {
+    frame_encoder_set_origin(renderer->encoder, row, col);
+}
+
+const EncodeOptions* pixi_renderer_options(const PixiRenderer *renderer) {
+    return frame_encoder_options(renderer->encoder);
+}
+
+void pixi_renderer_pixel_size(const PixiRenderer *renderer, int width, int height,
+                              int *scaled_width, int *scaled_height) {
+    glyph_grid_size(frame_encoder_options(renderer->encoder)->glyph_mode, width, height,
+                    renderer->cols, renderer->rows, scaled_width, scaled_height);
+}
+
+int pixi_renderer_band_count(const PixiRenderer *renderer, int scaled_height) {
+    return frame_encoder_band_count(renderer->encoder, scaled_height);
+}
+
+// buffers only ever grow
+// 0 on success, -1 on allocation failure
+static int reserve_buffers(PixiRenderer *renderer, int width, int height, int scale) {
+    if (scale) {
+        size_t size = (size_t)width * height * 3;
+        if (size > renderer->pixels_capacity) {
+            unsigned char *pixels = realloc(renderer->pixels, size);
+            if (!pixels) return -1;
+            renderer->pixels = pixels;
+            renderer->pixels_capacity = size;
+        }
+    }
+
+    size_t size = CLEAR_SCREEN_LEN + frame_encoder_buffer_size(renderer->encoder, width, height);
+    if (size > renderer->buffer_capacity) {
+        char *buffer = realloc(renderer->buffer, size);
+        if (!buffer) return -1;
+        renderer->buffer = buffer;
+        renderer->buffer_capacity = size;
+    }
+
+    int bands = 1 + frame_encoder_band_count(renderer->encoder, height);
+    if (bands > renderer->band_capacity) {
+        struct iovec *iov = realloc(renderer->bands, bands * sizeof(struct iovec));
+        if (!iov) return -1;
+        renderer->bands = iov;
+        renderer->band_capacity = bands;
+    }
+    return 0;
+}
+
+int pixi_writev_all(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count < IOV_MAX ? count : IOV_MAX);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        // skip what went out, resume mid band after a short write
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+ssize_t pixi_renderer_encode(PixiRenderer *renderer, const unsigned char *pixels, int width, int height,
+                             int stride, int scaled_width, int scaled_height, struct iovec **bands,
+                             int *band_count, int *clear) {
+    if (width < 1 || height < 1 || scaled_width < 1 || scaled_height < 1) return -1;
+
+    int scale = scaled_width != width || scaled_height != height;
+    if (reserve_buffers(renderer, scaled_width, scaled_height, scale) < 0) {
+        fprintf(stderr, "Failed to grow renderer buffers\n");
+        return -1;
+    }
+
+    if (scale) {
+        Scaler *scaler = renderer->scaler;
+        if (!scaler || scaler->src_width != width || scaler->src_height != height ||
+            scaler->dst_width != scaled_width || scaler->dst_height != scaled_height) {
+            scaler_free(scaler);
+            renderer->scaler = scaler = scaler_create(width, height, scaled_width, scaled_height,
+                                                      frame_encoder_options(renderer->encoder)->threads);
+            if (!scaler) {
+                fprintf(stderr, "Failed to create scaler\n");
+                return -1;
+            }
+        }
+        scaler_run(scaler, pixels, stride, renderer->pixels, scaled_width * 3);
+        pixels = renderer->pixels;
+        stride = scaled_width * 3;
+    }
+
+    // a smaller frame than before would leave the old one around its edges
+    *clear = scaled_width != renderer->drawn_width || scaled_height != renderer->drawn_height;
+    if (*clear) {
+        frame_encoder_reset_delta(renderer->encoder);
+        renderer->drawn_width = scaled_width;
+        renderer->drawn_height = scaled_height;
+    }
+
+    // bands[0] is left for the clear pixi_renderer_draw puts in front
+    *bands = renderer->bands + 1;
+    return frame_encoder_encode_bands(renderer->encoder, pixels, scaled_width, scaled_height, stride,
+                                      renderer->buffer + CLEAR_SCREEN_LEN, *bands, band_count);
+}
+
+ssize_t pixi_renderer_draw(PixiRenderer *renderer, const unsigned char *pixels, int width, int height,
+                           int stride) {
+    int scaled_width, scaled_height;
+    pixi_renderer_pixel_size(renderer, width, height, &scaled_width, &scaled_height);
+    return pixi_renderer_draw_sized(renderer, pixels, width, height, stride, scaled_width, scaled_height);
+}
+
+ssize_t pixi_renderer_draw_sized(PixiRenderer *renderer, const unsigned char *pixels, int width, int height,
+                                 int stride, int scaled_width, int scaled_height) {
+    struct iovec *bands;
+    int band_count, clear;
+    ssize_t len = pixi_renderer_encode(renderer, pixels, width, height, stride, scaled_width, scaled_height,
+                                       &bands, &band_count, &clear);
+    if (len < 0) return -1;
+
+    if (clear) {
+        memcpy(renderer->buffer, CLEAR_SCREEN, CLEAR_SCREEN_LEN);
+        renderer->bands[0].iov_base = renderer->buffer;
+        renderer->bands[0].iov_len = CLEAR_SCREEN_LEN;
+        bands--;
+        band_count++;
+        len += CLEAR_SCREEN_LEN;
+    }
+
+    switch (renderer->output) {
+        case OUTPUT_MEMORY: {
+            // bands packed behind each other from the start of the buffer
+            char *out = renderer->buffer;
+            for (int i = 0; i < band_count; i++) {
+                memmove(out, bands[i].iov_base, bands[i].iov_len);
+                out += bands[i].iov_len;
+            }
+            renderer->output_len = len;
+            break;
+        }
+        case OUTPUT_FD:
+            if (pixi_writev_all(renderer->fd, bands, band_count) < 0) {
+                perror("write");
+                return -1;
+            }
+            break;
+        case OUTPUT_CALLBACK:
+            if (band_count > 0 && renderer->write(renderer->user, bands, band_count) < 0) {
+                return -1;
+            }
+            break;
+    }
+    return len;
+}
+
+const char* pixi_renderer_output(const PixiRenderer *renderer, size_t *len) {
+    *len = renderer->output_len;
+    return renderer->buffer;
+}
@@ -0,0 +1,92 @@
+#ifndef PIXIL_H
+#define PIXIL_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "pixir.h"
+
+// libpixi: draws RGB frames of any size on a character grid, for programs
+// embedding pixi instead of running it
+// a renderer owns everything one view needs: the grid, an encoder (color
+// and delta state), the scaler, preallocated buffers and the output
+// no globals => any number of renderers, each used by one thread at a time
+
+// reset colors, clear screen => nothing drawn before survives
+#define CLEAR_SCREEN "\033[0m\033[2J"
+#define CLEAR_SCREEN_LEN 8
+
+typedef struct PixiRenderer PixiRenderer;
+
+// callback output: the bands of one frame in order
+// 0 on success, -1 on error (the draw fails)
+typedef int (*PixiWriteFn)(void *user, const struct iovec *bands, int count);
+
+// cols x rows cells, frames keep their aspect inside them
+// output starts out as memory, see pixi_renderer_output
+// NULL on error
+PixiRenderer* pixi_renderer_create(int cols, int rows, const EncodeOptions *options);
+
+void pixi_renderer_free(PixiRenderer *renderer);
+
+// where frames go, the fd is not closed by the renderer
+void pixi_renderer_output_fd(PixiRenderer *renderer, int fd);
+void pixi_renderer_output_callback(PixiRenderer *renderer, PixiWriteFn write, void *user);
+void pixi_renderer_output_memory(PixiRenderer *renderer);
+
+// new grid, the next frame clears the screen and repaints everything
+// 0 on success, -1 on error (the old grid stays)
+int pixi_renderer_resize(PixiRenderer *renderer, int cols, int rows);
+
+// the next frame is a full repaint, the screen isn't cleared for it
+void pixi_renderer_repaint(PixiRenderer *renderer);
+
+// screen cell of a frame's top left corner, 0, 0 unless set
+void pixi_renderer_set_origin(PixiRenderer *renderer, int row, int col);
+
+const EncodeOptions* pixi_renderer_options(const PixiRenderer *renderer);
+
+// pixels of the glyph grid a width x height source is drawn at
+void pixi_renderer_pixel_size(const PixiRenderer *renderer, int width, int height,
+                              int *scaled_width, int *scaled_height);
+
+// most bands a frame scaled_height pixels high encodes to
+int pixi_renderer_band_count(const PixiRenderer *renderer, int scaled_height);
+
+// RGB24 pixels, rows stride bytes apart, scaled to the grid, encoded and
+// output
+// the first frame, and the first after the drawn size changes, clears
+// the screen first
+// returns bytes output (0 => nothing changed in delta mode), -1 on error
+ssize_t pixi_renderer_draw(PixiRenderer *renderer, const unsigned char *pixels, int width, int height,
+                           int stride);
+
+// pixi_renderer_draw at scaled_width x scaled_height instead of the size
+// fitted to the source, for sources already scaled to the
+// pixi_renderer_pixel_size of their original size (drawn as they are)
+ssize_t pixi_renderer_draw_sized(PixiRenderer *renderer, const unsigned char *pixels, int width, int height,
+                                 int stride, int scaled_width, int scaled_height);
+
+// pixi_renderer_draw without the output, for views that lay out and write
+// frames themselves (video wall tiles, frame server groups)
+// pixels are scaled to exactly scaled_width x scaled_height unless they
+// already are that size
+// *bands: the encoded bands, valid until the next draw or encode
+// *clear: the drawn size changed => a full repaint, the screen should be
+// cleared before it (not part of *bands)
+// returns bytes in *bands (0 => nothing changed in delta mode), -1 on error
+ssize_t pixi_renderer_encode(PixiRenderer *renderer, const unsigned char *pixels, int width, int height,
+                             int stride, int scaled_width, int scaled_height, struct iovec **bands,
+                             int *band_count, int *clear);
+
+// writev all count bands to fd in order, retrying short writes and
+// splitting lists longer than IOV_MAX
+// iov is consumed (bases / lengths advanced)
+// 0 on success, -1 on error
+int pixi_writev_all(int fd, struct iovec *iov, int count);
+
+// memory output: the last frame's bytes, valid until the next draw
+const char* pixi_renderer_output(const PixiRenderer *renderer, size_t *len);
+
+#endif
@@ -0,0 +1,116 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "pixil.h"
+
+// libpixi is reentrant: renderers drawing at the same time, each on its own
+// thread, must output exactly what each of them outputs drawing alone
+// meant to run under -fsanitize=thread (PIXI_SANITIZE=thread) as well
+// exit status 0 => every renderer matched
+
+#define RENDERERS 12
+#define FRAMES 20
+
+typedef struct {
+    int id;
+    uint64_t hash;  // fnv-1a over every byte output, in order
+    size_t total;
+    int failed;
+} RenderRun;
+
+static int collect(void *user, const struct iovec *bands, int count) {
+    RenderRun *run = user;
+    for (int i = 0; i < count; i++) {
+        const unsigned char *p = bands[i].iov_base;
+        for (size_t k = 0; k < bands[i].iov_len; k++) {
+            run->hash = (run->hash ^ p[k]) * 1099511628211ull;
+        }
+        run->total += bands[i].iov_len;
+    }
+    return 0;
+}
+
+// moving gradient with a block of noise => delta frames change some cells
+static void fill(unsigned char *pixels, int width, int height, int stride, int frame) {
+    unsigned int seed = 2463534242u + frame;
+    for (int y = 0; y < height; y++) {
+        unsigned char *row = pixels + (size_t)y * stride;
+        for (int x = 0; x < width; x++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            int noisy = x > frame * 8 && x < frame * 8 + 40 && y > 40 && y < 100;
+            row[x * 3 + 0] = noisy ? seed : x + frame * 3;
+            row[x * 3 + 1] = noisy ? seed >> 8 : y * 2;
+            row[x * 3 + 2] = noisy ? seed >> 16 : (x + y) / 2;
+        }
+    }
+}
+
+// every renderer gets other settings, a source it has to scale and a new
+// grid halfway through
+static void* render(void *arg) {
+    RenderRun *run = arg;
+    run->hash = 14695981039346656037ull;
+
+    EncodeOptions options;
+    encode_default_options(&options);
+    options.delta = run->id & 1;
+    options.glyph_mode = (GlyphMode)(run->id % 4);
+    options.color_mode = (ColorMode)((run->id / 4) % 3);
+    options.threads = 1 + run->id % 3;
+    options.run_length_flags = 3;
+
+    int width = 320 + run->id * 8, height = 180, stride = width * 3 + 5;
+    unsigned char *pixels = malloc((size_t)stride * height);
+    PixiRenderer *renderer = pixi_renderer_create(60 + run->id, 20 + run->id % 5, &options);
+    if (!pixels || !renderer) {
+        run->failed = 1;
+    } else {
+        pixi_renderer_output_callback(renderer, collect, run);
+        for (int frame = 0; frame < FRAMES && !run->failed; frame++) {
+            if (frame == FRAMES / 2 && pixi_renderer_resize(renderer, 50, 15) < 0) run->failed = 1;
+            fill(pixels, width, height, stride, frame + run->id);
+            if (pixi_renderer_draw(renderer, pixels, width, height, stride) < 0) run->failed = 1;
+        }
+    }
+    pixi_renderer_free(renderer);
+    free(pixels);
+    return NULL;
+}
+
+int main(void) {
+    RenderRun alone[RENDERERS], together[RENDERERS];
+    memset(alone, 0, sizeof(alone));
+    memset(together, 0, sizeof(together));
+
+    for (int i = 0; i < RENDERERS; i++) {
+        alone[i].id = together[i].id = i;
+        render(&alone[i]);
+    }
+
+    pthread_t threads[RENDERERS];
+    int started[RENDERERS];
+    for (int i = 0; i < RENDERERS; i++) {
+        started[i] = pthread_create(&threads[i], NULL, render, &together[i]) == 0;
+        if (!started[i]) render(&together[i]);
+    }
+    for (int i = 0; i < RENDERERS; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+
+    int failed = 0;
+    for (int i = 0; i < RENDERERS; i++) {
+        if (alone[i].failed || together[i].failed || alone[i].total == 0 ||
+            alone[i].hash != together[i].hash || alone[i].total != together[i].total) {
+            fprintf(stderr, "renderer %d: %zu bytes alone, %zu at once%s\n", i, alone[i].total,
+                    together[i].total, alone[i].failed || together[i].failed ? ", draw failed" : "");
+            failed++;
+        }
+    }
+    printf("renderers: %d of %d matched drawing at once\n", RENDERERS - failed, RENDERERS);
+    return failed ? 1 : 0;
+}
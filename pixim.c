@@ -0,0 +1,283 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "pixim.h"
+#include "pixit.h"
+
+static const char *STAGE_NAMES[METRIC_STAGES] = {"decode", "convert", "scale", "encode", "write"};
+static const char *STAGE_SHORT[METRIC_STAGES] = {"dec", "cvt", "scl", "enc", "wr"};
+
+struct MetricsReporter {
+    Metrics *metrics;
+    int fd;
+    int is_socket;
+    int interval_ms;
+    pthread_t thread;
+    _Atomic int stop;
+    MetricSnapshot prev;
+};
+
+void metrics_init(Metrics *metrics) {
+    memset(metrics, 0, sizeof(Metrics));
+}
+
+void metrics_snapshot(Metrics *metrics, MetricSnapshot *snapshot) {
+    snapshot->time_ns = clock_now_ns();
+    for (int s = 0; s < METRIC_STAGES; s++) {
+        StageMetric *m = &metrics->stages[s];
+        snapshot->count[s] = atomic_load_explicit(&m->count, memory_order_relaxed);
+        snapshot->total_ns[s] = atomic_load_explicit(&m->total_ns, memory_order_relaxed);
+        for (int b = 0; b < METRIC_BUCKETS; b++) {
+            snapshot->buckets[s][b] = atomic_load_explicit(&m->buckets[b], memory_order_relaxed);
+        }
+    }
+    snapshot->frames = atomic_load_explicit(&metrics->frames, memory_order_relaxed);
+    snapshot->bytes = atomic_load_explicit(&metrics->bytes, memory_order_relaxed);
+    snapshot->stall_ns = atomic_load_explicit(&metrics->stall_ns, memory_order_relaxed);
+    snapshot->pixels_queued = atomic_load_explicit(&metrics->pixels_queued, memory_order_relaxed);
+    snapshot->bytes_queued = atomic_load_explicit(&metrics->bytes_queued, memory_order_relaxed);
+    snapshot->queue_capacity = atomic_load_explicit(&metrics->queue_capacity, memory_order_relaxed);
+    snapshot->dropped = atomic_load_explicit(&metrics->dropped, memory_order_relaxed);
+    snapshot->late = atomic_load_explicit(&metrics->late, memory_order_relaxed);
+}
+
+// counters only grow, prev NULL => since start
+static inline uint64_t delta(uint64_t now, const uint64_t *prev) {
+    return prev && now >= *prev ? now - *prev : now;
+}
+
+static double mean_ms(const MetricSnapshot *now, const MetricSnapshot *prev, int s) {
+    uint64_t count = delta(now->count[s], prev ? &prev->count[s] : NULL);
+    uint64_t total = delta(now->total_ns[s], prev ? &prev->total_ns[s] : NULL);
+    return count ? (double)total / (double)count / 1000000.0 : 0.0;
+}
+
+// upper edge of the bucket holding the p-th percentile, in ms
+// within 2x of the real value, which is what a live view needs
+static double percentile_ms(const MetricSnapshot *now, const MetricSnapshot *prev, int s, int p) {
+    uint64_t counts[METRIC_BUCKETS];
+    uint64_t total = 0;
+    for (int b = 0; b < METRIC_BUCKETS; b++) {
+        counts[b] = delta(now->buckets[s][b], prev ? &prev->buckets[s][b] : NULL);
+        total += counts[b];
+    }
+    if (total == 0) return 0.0;
+
+    uint64_t rank = (total * p + 99) / 100;
+    uint64_t seen = 0;
+    for (int b = 0; b < METRIC_BUCKETS; b++) {
+        seen += counts[b];
+        if (seen >= rank) {
+            return (double)(1ull << b) / 1000.0;
+        }
+    }
+    return (double)(1ull << (METRIC_BUCKETS - 1)) / 1000.0;
+}
+
+static double interval_seconds(const MetricSnapshot *now, const MetricSnapshot *prev) {
+    int64_t ns = prev ? now->time_ns - prev->time_ns : 0;
+    return ns > 0 ? (double)ns / 1000000000.0 : 0.0;
+}
+
+// snprintf that keeps pos inside the buffer
+#define APPEND(buf, len, pos, ...) do {                              \
+    if ((size_t)(pos) < (len)) {                                     \
+        int n_ = snprintf((buf) + (pos), (len) - (pos), __VA_ARGS__); \
+        if (n_ > 0) (pos) += n_;                                     \
+    }                                                                \
+} while (0)
+
+int metrics_format_status(const MetricSnapshot *now, const MetricSnapshot *prev, char *buf, size_t len) {
+    size_t pos = 0;
+    if (len == 0) return 0;
+    buf[0] = '\0';
+
+    for (int s = 0; s < METRIC_STAGES; s++) {
+        if (delta(now->count[s], prev ? &prev->count[s] : NULL) == 0) continue;
+        APPEND(buf, len, pos, "%s %.1f ", STAGE_SHORT[s], mean_ms(now, prev, s));
+    }
+
+    uint64_t frames = delta(now->frames, prev ? &prev->frames : NULL);
+    uint64_t bytes = delta(now->bytes, prev ? &prev->bytes : NULL);
+    double seconds = interval_seconds(now, prev);
+
+    APPEND(buf, len, pos, "ms | %.1f fps | %.1f KB/f | q %d+%d/%d | drop %d late %d | stall %.0f ms",
+           seconds > 0 ? frames / seconds : 0.0,
+           frames ? (double)bytes / frames / 1024.0 : 0.0,
+           now->pixels_queued, now->bytes_queued, now->queue_capacity,
+           now->dropped, now->late,
+           (double)delta(now->stall_ns, prev ? &prev->stall_ns : NULL) / 1000000.0);
+
+    return pos < len ? (int)pos : (int)len - 1;
+}
+
+int metrics_format_json(const MetricSnapshot *now, const MetricSnapshot *prev, char *buf, size_t len) {
+    size_t pos = 0;
+    if (len == 0) return 0;
+    buf[0] = '\0';
+
+    uint64_t frames = delta(now->frames, prev ? &prev->frames : NULL);
+    uint64_t bytes = delta(now->bytes, prev ? &prev->bytes : NULL);
+    double seconds = interval_seconds(now, prev);
+
+    APPEND(buf, len, pos,
+           "{\"time_ms\":%lld,\"interval_ms\":%.0f,\"frames\":%llu,\"frames_total\":%llu,\"fps\":%.2f,"
+           "\"bytes_per_frame\":%.0f,\"dropped\":%d,\"late\":%d,\"write_stall_ms\":%.3f,"
+           "\"queues\":{\"pixels\":%d,\"bytes\":%d,\"capacity\":%d},\"stages\":{",
+           (long long)(now->time_ns / 1000000), seconds * 1000.0,
+           (unsigned long long)frames, (unsigned long long)now->frames,
+           seconds > 0 ? frames / seconds : 0.0,
+           frames ? (double)bytes / frames : 0.0,
+           now->dropped, now->late,
+           (double)delta(now->stall_ns, prev ? &prev->stall_ns : NULL) / 1000000.0,
+           now->pixels_queued, now->bytes_queued, now->queue_capacity);
+
+    int first = 1;
+    for (int s = 0; s < METRIC_STAGES; s++) {
+        uint64_t count = delta(now->count[s], prev ? &prev->count[s] : NULL);
+        if (count == 0) continue;
+
+        APPEND(buf, len, pos, "%s\"%s\":{\"count\":%llu,\"mean_ms\":%.3f,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"hist_us\":[",
+               first ? "" : ",", STAGE_NAMES[s], (unsigned long long)count, mean_ms(now, prev, s),
+               percentile_ms(now, prev, s, 50), percentile_ms(now, prev, s, 99));
+        for (int b = 0; b < METRIC_BUCKETS; b++) {
+            APPEND(buf, len, pos, "%s%llu", b ? "," : "",
+                   (unsigned long long)delta(now->buckets[s][b], prev ? &prev->buckets[s][b] : NULL));
+        }
+        APPEND(buf, len, pos, "]}");
+        first = 0;
+    }
+    APPEND(buf, len, pos, "}}\n");
+
+    return pos < len ? (int)pos : (int)len - 1;
+}
+
+static int open_target(const char *target, int *is_socket) {
+    *is_socket = strncmp(target, "unix:", 5) == 0;
+    if (!*is_socket) {
+        return open(target, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    }
+
+    const char *path = target + 5;
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+// one line out, -1 once the file / collector is gone
+static int emit_line(MetricsReporter *reporter, const char *line, size_t len) {
+    while (len > 0) {
+        // MSG_NOSIGNAL => a collector going away is an error, not a SIGPIPE
+        ssize_t n = reporter->is_socket
+            ? send(reporter->fd, line, len, MSG_NOSIGNAL)
+            : write(reporter->fd, line, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        line += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void report(MetricsReporter *reporter) {
+    if (reporter->fd < 0) return;
+
+    MetricSnapshot now;
+    metrics_snapshot(reporter->metrics, &now);
+
+    char line[4096];
+    int len = metrics_format_json(&now, &reporter->prev, line, sizeof(line));
+    if (emit_line(reporter, line, len) < 0) {
+        fprintf(stderr, "Warning: stats output failed, no more stats\n");
+        close(reporter->fd);
+        reporter->fd = -1;
+    }
+    reporter->prev = now;
+}
+
+static void* reporter_thread(void *arg) {
+    MetricsReporter *reporter = arg;
+    int64_t interval_ns = (int64_t)reporter->interval_ms * 1000000;
+    int64_t next = clock_now_ns() + interval_ns;
+
+    while (!atomic_load(&reporter->stop)) {
+        // short naps so stopping never waits a whole interval
+        int64_t now = clock_now_ns();
+        if (now < next) {
+            int64_t nap = next - now < 50000000 ? next - now : 50000000;
+            clock_sleep_until_ns(now + nap);
+            continue;
+        }
+
+        report(reporter);
+        next += interval_ns;
+        if (next < now) next = now + interval_ns;
+    }
+    return NULL;
+}
+
+MetricsReporter* metrics_reporter_start(Metrics *metrics, const char *target, int interval_ms) {
+    MetricsReporter *reporter = calloc(1, sizeof(MetricsReporter));
+    if (!reporter) return NULL;
+
+    reporter->fd = open_target(target, &reporter->is_socket);
+    if (reporter->fd < 0) {
+        fprintf(stderr, "Could not open stats output %s: %s\n", target, strerror(errno));
+        free(reporter);
+        return NULL;
+    }
+
+    reporter->metrics = metrics;
+    reporter->interval_ms = interval_ms > 0 ? interval_ms : 1000;
+    atomic_init(&reporter->stop, 0);
+    metrics_snapshot(metrics, &reporter->prev);
+
+    if (pthread_create(&reporter->thread, NULL, reporter_thread, reporter) != 0) {
+        fprintf(stderr, "Could not start stats reporter\n");
+        close(reporter->fd);
+        free(reporter);
+        return NULL;
+    }
+    return reporter;
+}
+
+void metrics_reporter_stop(MetricsReporter *reporter) {
+    if (!reporter) return;
+
+    atomic_store(&reporter->stop, 1);
+    pthread_join(reporter->thread, NULL);
+
+    // whatever happened since the last tick
+    report(reporter);
+
+    if (reporter->fd >= 0) {
+        close(reporter->fd);
+    }
+    free(reporter);
+}
@@ -0,0 +1,116 @@
+#ifndef PIXIM_H
+#define PIXIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// live playback metrics
+// every counter has exactly one writer thread (the stage it belongs to), so
+// recording is a few relaxed loads / stores, no locks and no rmw
+// readers (status line, reporter) snapshot whenever they like
+typedef enum {
+    METRIC_DECODE,
+    METRIC_CONVERT,
+    METRIC_SCALE,
+    METRIC_ENCODE,
+    METRIC_WRITE,
+    METRIC_STAGES
+} MetricStage;
+
+// bucket 0 is < 1us, bucket i >= 1 is [2^(i-1), 2^i) us, the last one open
+#define METRIC_BUCKETS 24
+
+// writes blocking longer than this count as terminal stalls
+#define METRIC_STALL_NS 1000000
+
+typedef struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t total_ns;
+    _Atomic uint64_t buckets[METRIC_BUCKETS];
+} StageMetric;
+
+typedef struct {
+    StageMetric stages[METRIC_STAGES];
+
+    // write stage
+    _Atomic uint64_t frames;
+    _Atomic uint64_t bytes;
+    _Atomic uint64_t stall_ns;
+
+    // gauges, refreshed by the write stage every frame
+    _Atomic int pixels_queued;
+    _Atomic int bytes_queued;
+    _Atomic int queue_capacity;
+    _Atomic int dropped;
+    _Atomic int late;
+} Metrics;
+
+// plain copy of Metrics at one point in time
+typedef struct {
+    int64_t time_ns;
+    uint64_t count[METRIC_STAGES];
+    uint64_t total_ns[METRIC_STAGES];
+    uint64_t buckets[METRIC_STAGES][METRIC_BUCKETS];
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t stall_ns;
+    int pixels_queued;
+    int bytes_queued;
+    int queue_capacity;
+    int dropped;
+    int late;
+} MetricSnapshot;
+
+void metrics_init(Metrics *metrics);
+
+// single writer increment, cheaper than atomic_fetch_add
+static inline void metric_add(_Atomic uint64_t *counter, uint64_t value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+}
+
+static inline int metric_bucket(int64_t ns) {
+    uint64_t us = ns > 0 ? (uint64_t)ns / 1000 : 0;
+    int bucket = us ? 64 - __builtin_clzll(us) : 0;
+    return bucket < METRIC_BUCKETS ? bucket : METRIC_BUCKETS - 1;
+}
+
+// call only from the thread that owns stage
+static inline void metrics_record(Metrics *metrics, MetricStage stage, int64_t ns) {
+    StageMetric *m = &metrics->stages[stage];
+    metric_add(&m->count, 1);
+    metric_add(&m->total_ns, ns > 0 ? (uint64_t)ns : 0);
+    metric_add(&m->buckets[metric_bucket(ns)], 1);
+}
+
+// write stage: one frame of bytes went out, write_ns spent inside write
+static inline void metrics_record_frame(Metrics *metrics, size_t bytes, int64_t write_ns) {
+    metrics_record(metrics, METRIC_WRITE, write_ns);
+    metric_add(&metrics->frames, 1);
+    metric_add(&metrics->bytes, bytes);
+    if (write_ns > METRIC_STALL_NS) {
+        metric_add(&metrics->stall_ns, (uint64_t)write_ns);
+    }
+}
+
+void metrics_snapshot(Metrics *metrics, MetricSnapshot *snapshot);
+
+// one line summary of what happened between prev and now, for the status line
+// returns chars written (truncated to len - 1)
+int metrics_format_status(const MetricSnapshot *now, const MetricSnapshot *prev, char *buf, size_t len);
+
+// one json object + '\n' for the same interval
+int metrics_format_json(const MetricSnapshot *now, const MetricSnapshot *prev, char *buf, size_t len);
+
+// background thread appending metrics_format_json lines every interval_ms
+// target is a file path, or "unix:/path" for a listening unix stream socket
+typedef struct MetricsReporter MetricsReporter;
+
+// NULL on error
+MetricsReporter* metrics_reporter_start(Metrics *metrics, const char *target, int interval_ms);
+
+// writes a final line, then stops and frees the reporter
+void metrics_reporter_stop(MetricsReporter *reporter);
+
+#endif
@@ -0,0 +1,136 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "pixip.h"
+
+typedef struct {
+    WorkerPool *pool;
+    pthread_t thread;
+    int share;  // 1.. => the share it runs, 0 is the caller's
+} Worker;
+
+struct WorkerPool {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;  // new job or stop
+    pthread_cond_t done;  // pending reached 0
+
+    Worker *workers;
+    int started;
+
+    // current job, guarded by lock
+    unsigned generation;  // bumped per job => workers run each job once
+    WorkerTask task;
+    void *arg;
+    int shares;   // shares taken by workers this job, caller's included
+    int pending;  // workers still running their share
+    int stop;
+};
+
+static void* worker_main(void *arg) {
+    Worker *worker = arg;
+    WorkerPool *pool = worker->pool;
+    unsigned seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stop && pool->generation == seen) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        if (pool->stop) break;
+        seen = pool->generation;
+
+        // jobs with fewer shares than workers leave the rest asleep
+        if (worker->share >= pool->shares) continue;
+
+        WorkerTask task = pool->task;
+        void *task_arg = pool->arg;
+        pthread_mutex_unlock(&pool->lock);
+        task(task_arg, worker->share);
+        pthread_mutex_lock(&pool->lock);
+
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+WorkerPool* worker_pool_create(int threads) {
+    WorkerPool *pool = calloc(1, sizeof(WorkerPool));
+    if (!pool) return NULL;
+
+    int count = threads > 1 ? threads - 1 : 0;
+    if (count > 0) {
+        pool->workers = calloc(count, sizeof(Worker));
+        if (!pool->workers) {
+            free(pool);
+            return NULL;
+        }
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // workers fill shares 1.. in order => one that fails to start ends the
+    // list, worker_pool_run gives the caller what it would have taken
+    for (int i = 0; i < count; i++) {
+        Worker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->share = i + 1;
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) break;
+        pool->started++;
+    }
+    return pool;
+}
+
+void worker_pool_free(WorkerPool *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->started; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+void worker_pool_run(WorkerPool *pool, WorkerTask task, void *arg, int shares) {
+    if (shares < 1) return;
+    int helpers = shares - 1;
+    if (helpers > pool->started) helpers = pool->started;
+
+    if (helpers > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pool->task = task;
+        pool->arg = arg;
+        pool->shares = helpers + 1;
+        pool->pending = helpers;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    task(arg, 0);
+    // shares beyond the workers that started
+    for (int share = helpers + 1; share < shares; share++) {
+        task(arg, share);
+    }
+
+    if (helpers > 0) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->pending > 0) {
+            pthread_cond_wait(&pool->done, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef PIXIP_H
+#define PIXIP_H
+
+// worker threads started once and woken for every job, so per frame work
+// split over cores doesn't pay for spawning and joining threads each time
+typedef struct WorkerPool WorkerPool;
+
+// share: [0, shares) of the job, each runs exactly once per worker_pool_run
+typedef void (*WorkerTask)(void *arg, int share);
+
+// threads: shares run at once, calling thread included => threads - 1
+// workers, fewer if some fail to start (the caller picks up their shares)
+// NULL on allocation failure
+WorkerPool* worker_pool_create(int threads);
+
+// stops and joins the workers
+void worker_pool_free(WorkerPool *pool);
+
+// task(arg, share) for every share, spread over the workers with share 0
+// on the calling thread, returns once all of them are done
+// one job at a time per pool
+void worker_pool_run(WorkerPool *pool, WorkerTask task, void *arg, int shares);
+
+#endif
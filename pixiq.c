@@ -0,0 +1,102 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <sched.h>
+#include <time.h>
+
+#include "pixiq.h"
+
+int frame_queue_init(FrameQueue *queue, size_t capacity) {
+    queue->items = calloc(capacity, sizeof(void *));
+    if (!queue->items) {
+        return -1;
+    }
+    queue->capacity = capacity;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->closed, 0);
+    return 0;
+}
+
+void frame_queue_destroy(FrameQueue *queue) {
+    free(queue->items);
+    queue->items = NULL;
+    queue->capacity = 0;
+}
+
+int frame_queue_try_push(FrameQueue *queue, void *item) {
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    if (tail - head >= queue->capacity) {
+        return 0;
+    }
+
+    queue->items[tail % queue->capacity] = item;
+    // publish item before the new tail
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+int frame_queue_try_pop(FrameQueue *queue, void **item) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    if (head == tail) {
+        return 0;
+    }
+
+    *item = queue->items[head % queue->capacity];
+    // slot is free for the producer once head moves
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return 1;
+}
+
+// spin briefly, then yield, then sleep so an idle stage doesnt burn a core
+static void backoff(int *spins) {
+    if (*spins < 64) {
+        (*spins)++;
+    } else if (*spins < 128) {
+        (*spins)++;
+        sched_yield();
+    } else {
+        struct timespec ts = {0, 200 * 1000};
+        nanosleep(&ts, NULL);
+    }
+}
+
+int frame_queue_push(FrameQueue *queue, void *item, volatile sig_atomic_t *stop) {
+    int spins = 0;
+    while (!frame_queue_try_push(queue, item)) {
+        if (stop && *stop) {
+            return 0;
+        }
+        backoff(&spins);
+    }
+    return 1;
+}
+
+int frame_queue_pop(FrameQueue *queue, void **item, volatile sig_atomic_t *stop) {
+    int spins = 0;
+    while (!frame_queue_try_pop(queue, item)) {
+        if (stop && *stop) {
+            return 0;
+        }
+        if (atomic_load_explicit(&queue->closed, memory_order_acquire)) {
+            // closed flag may have been set right after a final push
+            return frame_queue_try_pop(queue, item);
+        }
+        backoff(&spins);
+    }
+    return 1;
+}
+
+size_t frame_queue_size(FrameQueue *queue) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    return tail >= head ? tail - head : 0;
+}
+
+void frame_queue_close(FrameQueue *queue) {
+    atomic_store_explicit(&queue->closed, 1, memory_order_release);
+}
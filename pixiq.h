@@ -0,0 +1,39 @@
+#ifndef PIXIQ_H
+#define PIXIQ_H
+
+#include <stddef.h>
+#include <signal.h>
+#include <stdatomic.h>
+
+// bounded single producer / single consumer ring of pointers
+// lock free: producer only writes tail, consumer only writes head
+typedef struct {
+    void **items;
+    size_t capacity;
+    _Atomic size_t head;  // next index to pop
+    _Atomic size_t tail;  // next index to push
+    _Atomic int closed;   // producer is done, drain then stop
+} FrameQueue;
+
+// 0 on success, -1 on allocation failure
+int frame_queue_init(FrameQueue *queue, size_t capacity);
+
+void frame_queue_destroy(FrameQueue *queue);
+
+// non blocking
+// 1 if pushed/popped, 0 if full/empty
+int frame_queue_try_push(FrameQueue *queue, void *item);
+int frame_queue_try_pop(FrameQueue *queue, void **item);
+
+// blocking with backoff
+// 0 once *stop is set (or the queue is closed and drained for pop)
+int frame_queue_push(FrameQueue *queue, void *item, volatile sig_atomic_t *stop);
+int frame_queue_pop(FrameQueue *queue, void **item, volatile sig_atomic_t *stop);
+
+// items currently queued, approximate while both sides run
+size_t frame_queue_size(FrameQueue *queue);
+
+// no more pushes, consumer drains what is left
+void frame_queue_close(FrameQueue *queue);
+
+#endif
@@ -0,0 +1,1230 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "pixir.h"
+#include "pixip.h"
+
+void encode_default_options(EncodeOptions *options) {
+    memset(options, 0, sizeof(EncodeOptions));
+    options->color_mode = COLOR_MODE_TRUECOLOR;
+    options->glyph_mode = GLYPH_HALF;
+    options->delta_threshold = 0.5f;
+    options->threads = 1;
+}
+
+// "ddd;" for every u8, copied with one fixed width 4 byte store
+// len includes the ';' so the next channel lands right after it
+typedef struct {
+    char s[4];
+    unsigned char len;
+} U8Fragment;
+
+#define U8_FRAGMENT(n) { {                                                    \
+    (n) >= 100 ? '0' + (n) / 100 : (n) >= 10 ? '0' + (n) / 10 : '0' + (n),   \
+    (n) >= 100 ? '0' + (n) / 10 % 10 : (n) >= 10 ? '0' + (n) % 10 : ';',     \
+    (n) >= 100 ? '0' + (n) % 10 : (n) >= 10 ? ';' : 0,                       \
+    (n) >= 100 ? ';' : 0 },                                                   \
+    (n) >= 100 ? 4 : (n) >= 10 ? 3 : 2 }
+#define U8_FRAGMENT4(n) U8_FRAGMENT(n), U8_FRAGMENT(n + 1), U8_FRAGMENT(n + 2), U8_FRAGMENT(n + 3)
+#define U8_FRAGMENT16(n) U8_FRAGMENT4(n), U8_FRAGMENT4(n + 4), U8_FRAGMENT4(n + 8), U8_FRAGMENT4(n + 12)
+#define U8_FRAGMENT64(n) U8_FRAGMENT16(n), U8_FRAGMENT16(n + 16), U8_FRAGMENT16(n + 32), U8_FRAGMENT16(n + 48)
+
+static const U8Fragment u8_fragments[256] = {
+    U8_FRAGMENT64(0), U8_FRAGMENT64(64), U8_FRAGMENT64(128), U8_FRAGMENT64(192)
+};
+
+// sgr prefixes padded to 8 bytes => one unaligned store each
+static const char SGR_FG[8] = "\033[38;2;";
+static const char SGR_BG[8] = "\033[48;2;";
+static const char SGR_AND_BG[8] = ";48;2;";
+
+// palette sgr prefixes, same 8 byte stores
+static const char SGR_FG_256[8] = "\033[38;5;";
+static const char SGR_BG_256[8] = "\033[48;5;";
+static const char SGR_AND_BG_256[8] = ";48;5;";
+
+// 16 color sgr parameters, fg 30-37 / 90-97, bg 40-47 / 100-107
+// padded to 4 bytes for fixed width stores
+static const char SGR16_FG[16][4] = {
+    "30", "31", "32", "33", "34", "35", "36", "37",
+    "90", "91", "92", "93", "94", "95", "96", "97"
+};
+static const char SGR16_BG[16][4] = {
+    "40", "41", "42", "43", "44", "45", "46", "47",
+    "100", "101", "102", "103", "104", "105", "106", "107"
+};
+
+// half block is 0xE2 0x96 0x84, 16 of them for run stores
+#define GLYPH_RUN 16
+static const char glyph_run[GLYPH_RUN * 3 + 1] = "▄▄▄▄▄▄▄▄▄▄▄▄▄▄▄▄";
+
+// packed 0xBBGGRR, never equal to a real color
+#define COLOR_UNKNOWN 0xFFFFFFFFu
+
+// active sgr colors
+typedef struct {
+    uint32_t fg;
+    uint32_t bg;
+} ColorState;
+
+static inline void reset_color_state(ColorState *state) {
+    state->fg = COLOR_UNKNOWN;
+    state->bg = COLOR_UNKNOWN;
+}
+
+static inline uint32_t pack_rgb(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+}
+
+// squared distance weighted roughly by how sensitive the eye is per channel
+static inline int color_distance(int r0, int g0, int b0, int r1, int g1, int b1) {
+    int dr = r0 - r1, dg = g0 - g1, db = b0 - b1;
+    return 2 * dr * dr + 4 * dg * dg + 3 * db * db;
+}
+
+// lossy settings, resolved once per encoder
+typedef struct {
+    int tolerance_sq;         // max color_distance still treated as equal, 0 => exact
+    unsigned char snap_mask;  // 0xFF => no snapping
+    unsigned char snap_half;  // snapped values sit mid bucket
+} Lossy;
+
+static Lossy lossy_settings(const EncodeOptions *options) {
+    Lossy lossy;
+    // scaled by the smallest weight (red's 2) => no single channel can be
+    // more than tolerance off, however the error is spread
+    lossy.tolerance_sq = 2 * options->color_tolerance * options->color_tolerance;
+    int snap = options->color_snap_bits;
+    int bits = snap < 0 ? 0 : snap > 7 ? 7 : snap;
+    lossy.snap_mask = (unsigned char)(0xFF << bits);
+    lossy.snap_half = bits ? (unsigned char)(1 << (bits - 1)) : 0;
+    return lossy;
+}
+
+// packed colors within tolerance of each other
+static inline int colors_close(uint32_t a, uint32_t b, int tolerance_sq) {
+    if (a == b) return 1;
+    if (tolerance_sq == 0 || b == COLOR_UNKNOWN) return 0;
+    return color_distance(a & 0xFF, (a >> 8) & 0xFF, a >> 16,
+                          b & 0xFF, (b >> 8) & 0xFF, b >> 16) <= tolerance_sq;
+}
+
+static inline int pixels_close(const unsigned char *a, const unsigned char *b, int tolerance_sq) {
+    if (memcmp(a, b, 3) == 0) return 1;
+    return tolerance_sq && color_distance(a[0], a[1], a[2], b[0], b[1], b[2]) <= tolerance_sq;
+}
+
+// "R;G;B" via the fragment table
+// may store up to 3 bytes past the returned position
+static inline char* put_rgb(char *buf, const unsigned char *p) {
+    const U8Fragment *r = &u8_fragments[p[0]];
+    const U8Fragment *g = &u8_fragments[p[1]];
+    const U8Fragment *b = &u8_fragments[p[2]];
+
+    memcpy(buf, r->s, 4);
+    buf += r->len;
+    memcpy(buf, g->s, 4);
+    buf += g->len;
+    memcpy(buf, b->s, 4);
+    return buf + b->len - 1;
+}
+
+// emit color codes (if needed) for one cell, the glyph follows
+// top => background, bot => foreground
+// lossy: colors close enough to the active ones keep the active ones
+// returns new buffer position
+static inline char* emit_colors(char *buf, ColorState *state, const Lossy *lossy,
+                                const unsigned char *top, const unsigned char *bot) {
+    unsigned char top_snapped[3], bot_snapped[3];
+    if (lossy->snap_mask != 0xFF) {
+        for (int c = 0; c < 3; c++) {
+            top_snapped[c] = (top[c] & lossy->snap_mask) | lossy->snap_half;
+            bot_snapped[c] = (bot[c] & lossy->snap_mask) | lossy->snap_half;
+        }
+        top = top_snapped;
+        bot = bot_snapped;
+    }
+
+    uint32_t fg = pack_rgb(bot);
+    uint32_t bg = pack_rgb(top);
+
+    // compare curr color state to needed
+    int fg_changed = !colors_close(fg, state->fg, lossy->tolerance_sq);
+    int bg_changed = !colors_close(bg, state->bg, lossy->tolerance_sq);
+
+    if (fg_changed) {
+        memcpy(buf, SGR_FG, 8);
+        buf = put_rgb(buf + 7, bot);
+        if (bg_changed) {
+            memcpy(buf, SGR_AND_BG, 8);
+            buf = put_rgb(buf + 6, top);
+        }
+        *buf++ = 'm';
+        state->fg = fg;
+    } else if (bg_changed) {
+        memcpy(buf, SGR_BG, 8);
+        buf = put_rgb(buf + 7, top);
+        *buf++ = 'm';
+    }
+    if (bg_changed) {
+        state->bg = bg;
+    }
+    return buf;
+}
+
+// nearest palette entry for every 5:5:5 color => one lookup per pixel
+// built once per mode on first use
+#define LUT_INDEX(p) ((((p)[0] >> 3) << 10) | (((p)[1] >> 3) << 5) | ((p)[2] >> 3))
+
+static unsigned char lut_256[32 * 32 * 32];
+static unsigned char lut_16[32 * 32 * 32];
+static pthread_once_t lut_256_once = PTHREAD_ONCE_INIT;
+static pthread_once_t lut_16_once = PTHREAD_ONCE_INIT;
+
+// xterm's default 16 color palette
+static const unsigned char PALETTE_16[16][3] = {
+    {0, 0, 0}, {205, 0, 0}, {0, 205, 0}, {205, 205, 0},
+    {0, 0, 238}, {205, 0, 205}, {0, 205, 205}, {229, 229, 229},
+    {127, 127, 127}, {255, 0, 0}, {0, 255, 0}, {255, 255, 0},
+    {92, 92, 255}, {255, 0, 255}, {0, 255, 255}, {255, 255, 255}
+};
+
+// 6x6x6 cube levels of palette entries 16-231
+static const int CUBE_LEVELS[6] = {0, 95, 135, 175, 215, 255};
+
+static int nearest_cube_level(int v) {
+    int best = 0;
+    for (int i = 1; i < 6; i++) {
+        if (abs(CUBE_LEVELS[i] - v) < abs(CUBE_LEVELS[best] - v)) best = i;
+    }
+    return best;
+}
+
+// cube + gray ramp only, entries 0-15 are themed by the terminal
+static unsigned char nearest_256(int r, int g, int b) {
+    int ri = nearest_cube_level(r), gi = nearest_cube_level(g), bi = nearest_cube_level(b);
+    int cube_dist = color_distance(r, g, b, CUBE_LEVELS[ri], CUBE_LEVELS[gi], CUBE_LEVELS[bi]);
+
+    // gray ramp 232-255 is 8 + 10 * i
+    int gray = (r + g + b) / 3;
+    int gi_ramp = gray < 8 ? 0 : gray > 238 ? 23 : (gray - 8 + 5) / 10;
+    int level = 8 + 10 * gi_ramp;
+    int gray_dist = color_distance(r, g, b, level, level, level);
+
+    return gray_dist < cube_dist ? 232 + gi_ramp : 16 + 36 * ri + 6 * gi + bi;
+}
+
+static unsigned char nearest_16(int r, int g, int b) {
+    int best = 0, best_dist = INT32_MAX;
+    for (int i = 0; i < 16; i++) {
+        int d = color_distance(r, g, b, PALETTE_16[i][0], PALETTE_16[i][1], PALETTE_16[i][2]);
+        if (d < best_dist) {
+            best = i;
+            best_dist = d;
+        }
+    }
+    return best;
+}
+
+// each 5:5:5 bucket maps from its center
+static void build_lut(unsigned char *lut, unsigned char (*nearest)(int, int, int)) {
+    for (int i = 0; i < 32 * 32 * 32; i++) {
+        lut[i] = nearest(((i >> 10) << 3) | 4, (((i >> 5) & 31) << 3) | 4, ((i & 31) << 3) | 4);
+    }
+}
+
+static void build_lut_256(void) { build_lut(lut_256, nearest_256); }
+static void build_lut_16(void) { build_lut(lut_16, nearest_16); }
+
+// NULL => truecolor
+static const unsigned char* palette_lut(ColorMode mode) {
+    switch (mode) {
+        case COLOR_MODE_256:
+            pthread_once(&lut_256_once, build_lut_256);
+            return lut_256;
+        case COLOR_MODE_16:
+            pthread_once(&lut_16_once, build_lut_16);
+            return lut_16;
+        default:
+            return NULL;
+    }
+}
+
+int palette_index(ColorMode mode, const unsigned char *rgb) {
+    const unsigned char *lut = palette_lut(mode);
+    return lut ? lut[LUT_INDEX(rgb)] : -1;
+}
+
+// "N" via the fragment table, may store up to 3 bytes past the returned position
+static inline char* put_u8(char *buf, unsigned char n) {
+    memcpy(buf, u8_fragments[n].s, 4);
+    return buf + u8_fragments[n].len - 1;
+}
+
+// emit_colors for palette modes, state holds palette indices instead of rgb
+static inline char* emit_palette_colors(char *buf, ColorState *state, ColorMode mode, const unsigned char *lut,
+                                        const unsigned char *top, const unsigned char *bot) {
+    uint32_t fg = lut[LUT_INDEX(bot)];
+    uint32_t bg = lut[LUT_INDEX(top)];
+
+    int fg_changed = fg != state->fg;
+    int bg_changed = bg != state->bg;
+
+    if (mode == COLOR_MODE_16) {
+        if (fg_changed || bg_changed) {
+            *buf++ = '\033';
+            *buf++ = '[';
+            if (fg_changed) {
+                memcpy(buf, SGR16_FG[fg], 4);
+                buf += 2;
+                if (bg_changed) *buf++ = ';';
+            }
+            if (bg_changed) {
+                memcpy(buf, SGR16_BG[bg], 4);
+                buf += bg < 8 ? 2 : 3;
+            }
+            *buf++ = 'm';
+        }
+    } else if (fg_changed) {
+        memcpy(buf, SGR_FG_256, 8);
+        buf = put_u8(buf + 7, fg);
+        if (bg_changed) {
+            memcpy(buf, SGR_AND_BG_256, 8);
+            buf = put_u8(buf + 6, bg);
+        }
+        *buf++ = 'm';
+    } else if (bg_changed) {
+        memcpy(buf, SGR_BG_256, 8);
+        buf = put_u8(buf + 7, bg);
+        *buf++ = 'm';
+    }
+    state->fg = fg;
+    state->bg = bg;
+    return buf;
+}
+
+static inline char* emit_glyphs(char *buf, int n) {
+    while (n >= GLYPH_RUN) {
+        memcpy(buf, glyph_run, GLYPH_RUN * 3);
+        buf += GLYPH_RUN * 3;
+        n -= GLYPH_RUN;
+    }
+    memcpy(buf, glyph_run, n * 3);
+    return buf + n * 3;
+}
+
+// glyph mode cells: bit i of a mask set => pixel i of the cell (row major)
+// takes the fg color, 0 => the cell is one color, drawn as a space
+typedef struct {
+    char s[4];  // utf-8, zero padded for 4 byte stores
+    unsigned char len;
+} Glyph;
+
+static Glyph glyphs_quadrant[16];
+static Glyph glyphs_sextant[64];
+static Glyph glyphs_braille[256];
+static pthread_once_t glyphs_once = PTHREAD_ONCE_INIT;
+
+static Glyph utf8_glyph(uint32_t cp) {
+    Glyph g;
+    memset(&g, 0, sizeof(g));
+    if (cp < 0x80) {
+        g.s[0] = cp;
+        g.len = 1;
+    } else if (cp < 0x10000) {
+        g.s[0] = 0xE0 | (cp >> 12);
+        g.s[1] = 0x80 | ((cp >> 6) & 0x3F);
+        g.s[2] = 0x80 | (cp & 0x3F);
+        g.len = 3;
+    } else {
+        g.s[0] = 0xF0 | (cp >> 18);
+        g.s[1] = 0x80 | ((cp >> 12) & 0x3F);
+        g.s[2] = 0x80 | ((cp >> 6) & 0x3F);
+        g.s[3] = 0x80 | (cp & 0x3F);
+        g.len = 4;
+    }
+    return g;
+}
+
+static void build_glyphs(void) {
+    // bits: top left, top right, bottom left, bottom right
+    static const uint16_t QUADRANTS[16] = {
+        ' ', 0x2598, 0x259D, 0x2580, 0x2596, 0x258C, 0x259E, 0x259B,
+        0x2597, 0x259A, 0x2590, 0x259C, 0x2584, 0x2599, 0x259F, 0x2588
+    };
+    for (int m = 0; m < 16; m++) {
+        glyphs_quadrant[m] = utf8_glyph(QUADRANTS[m]);
+    }
+
+    // symbols for legacy computing has the 60 sextants in mask order, minus
+    // the ones that already exist as half / full blocks
+    for (int m = 0; m < 64; m++) {
+        uint32_t cp = m == 0 ? ' ' : m == 21 ? 0x258C : m == 42 ? 0x2590 : m == 63 ? 0x2588
+                    : 0x1FB00 + m - 1 - (m > 21) - (m > 42);
+        glyphs_sextant[m] = utf8_glyph(cp);
+    }
+
+    // braille numbers its dots down the left column, then the right, with
+    // the bottom row (7, 8) added last
+    static const unsigned char DOTS[8] = {0x01, 0x08, 0x02, 0x10, 0x04, 0x20, 0x40, 0x80};
+    for (int m = 0; m < 256; m++) {
+        int dots = 0;
+        for (int i = 0; i < 8; i++) {
+            if (m & (1 << i)) dots |= DOTS[i];
+        }
+        glyphs_braille[m] = utf8_glyph(m == 0 ? ' ' : 0x2800 + dots);
+    }
+}
+
+// NULL => half block
+static const Glyph* glyph_table(GlyphMode mode) {
+    pthread_once(&glyphs_once, build_glyphs);
+    switch (mode) {
+        case GLYPH_QUADRANT: return glyphs_quadrant;
+        case GLYPH_SEXTANT: return glyphs_sextant;
+        case GLYPH_BRAILLE: return glyphs_braille;
+        default: return NULL;
+    }
+}
+
+void glyph_cell_size(GlyphMode mode, int *width, int *height) {
+    static const unsigned char CELL_SIZE[][2] = {
+        [GLYPH_HALF] = {1, 2},
+        [GLYPH_QUADRANT] = {2, 2},
+        [GLYPH_SEXTANT] = {2, 3},
+        [GLYPH_BRAILLE] = {2, 4}
+    };
+    *width = CELL_SIZE[mode][0];
+    *height = CELL_SIZE[mode][1];
+}
+
+void fit_aspect(int width, int height, int available_width, int available_height,
+                int *fit_width, int *fit_height) {
+    float img_aspect = (float)width / (float)height;
+    float box_aspect = (float)available_width / (float)available_height;
+
+    if (img_aspect > box_aspect) {
+        *fit_width = available_width;
+        *fit_height = (int)(available_width / img_aspect);
+    } else {
+        *fit_height = available_height;
+        *fit_width = (int)(available_height * img_aspect);
+    }
+}
+
+void glyph_grid_size(GlyphMode mode, int width, int height, int cols, int rows,
+                     int *scaled_width, int *scaled_height) {
+    // fit in half cell units, square on a cell twice as tall as wide
+    int fit_width, fit_height;
+    fit_aspect(width, height, cols, rows * 2, &fit_width, &fit_height);
+
+    // => pixels of the glyph grid, a cell is cell_width x cell_height of them
+    // (not square for quadrants / sextants, the scaler stretches to match)
+    int cell_width, cell_height;
+    glyph_cell_size(mode, &cell_width, &cell_height);
+    *scaled_width = fit_width * cell_width;
+    *scaled_height = fit_height * cell_height / 2;
+}
+
+// a cell whose pixels stay within this many levels on every channel gets
+// one color, a mask there would only draw noise for twice the sgr bytes
+#define FIT_MIN_RANGE 8
+
+// two colors + mask for the n <= 8 pixels of one cell
+// 2-means along the channel with the widest range: start halfway between
+// the extremes, one step moves the split halfway between the two means
+// the low side of that channel is the background
+static inline void fit_cell(const unsigned char px[8][3], int n,
+                            unsigned char *bg, unsigned char *fg, unsigned char *mask) {
+    int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+    for (int i = 0; i < n; i++) {
+        for (int c = 0; c < 3; c++) {
+            if (px[i][c] < lo[c]) lo[c] = px[i][c];
+            if (px[i][c] > hi[c]) hi[c] = px[i][c];
+        }
+    }
+    int axis = 0;
+    for (int c = 1; c < 3; c++) {
+        if (hi[c] - lo[c] > hi[axis] - lo[axis]) axis = c;
+    }
+
+    if (hi[axis] - lo[axis] < FIT_MIN_RANGE) {
+        int sum[3] = {0, 0, 0};
+        for (int i = 0; i < n; i++) {
+            for (int c = 0; c < 3; c++) sum[c] += px[i][c];
+        }
+        for (int c = 0; c < 3; c++) {
+            bg[c] = fg[c] = (sum[c] + n / 2) / n;
+        }
+        *mask = 0;
+        return;
+    }
+
+    // both sides stay non empty: the extremes are on opposite sides of
+    // either split
+    unsigned bits = 0;
+    int split2 = lo[axis] + hi[axis];
+    for (int i = 0; i < n; i++) {
+        bits |= (unsigned)(px[i][axis] * 2 > split2) << i;
+    }
+    int sum[2] = {0, 0}, count[2] = {0, 0};
+    for (int i = 0; i < n; i++) {
+        int side = (bits >> i) & 1;
+        sum[side] += px[i][axis];
+        count[side]++;
+    }
+    // v > (sum0 / count0 + sum1 / count1) / 2, without the divides
+    int lhs = 2 * count[0] * count[1];
+    int rhs = sum[0] * count[1] + sum[1] * count[0];
+    bits = 0;
+    for (int i = 0; i < n; i++) {
+        bits |= (unsigned)(px[i][axis] * lhs > rhs) << i;
+    }
+
+    int sums[2][3] = {{0, 0, 0}, {0, 0, 0}};
+    count[0] = count[1] = 0;
+    for (int i = 0; i < n; i++) {
+        int side = (bits >> i) & 1;
+        for (int c = 0; c < 3; c++) sums[side][c] += px[i][c];
+        count[side]++;
+    }
+    for (int c = 0; c < 3; c++) {
+        bg[c] = (sums[0][c] + count[0] / 2) / count[0];
+        fg[c] = (sums[1][c] + count[1] / 2) / count[1];
+    }
+    *mask = bits;
+}
+
+// one character row of cells as the span encoder reads it
+// half block mode points bg / fg straight at the top / bottom pixel rows
+typedef struct {
+    const unsigned char *bg;     // cols * 3
+    const unsigned char *fg;     // cols * 3
+    const unsigned char *masks;  // cols, NULL => half blocks
+} CellRow;
+
+#if defined(__AVX2__)
+#define REPEAT_BLOCK 32
+// bit i set <=> p[i] == p[i + 3] for i in [0, 96), split over two words
+// bits past 96 are set so only real mismatches show up
+static inline void repeat_mask(const unsigned char *p, uint64_t *lo, uint64_t *hi) {
+    __m256i a0 = _mm256_loadu_si256((const __m256i *)(p));
+    __m256i a1 = _mm256_loadu_si256((const __m256i *)(p + 32));
+    __m256i a2 = _mm256_loadu_si256((const __m256i *)(p + 64));
+    __m256i b0 = _mm256_loadu_si256((const __m256i *)(p + 3));
+    __m256i b1 = _mm256_loadu_si256((const __m256i *)(p + 35));
+    __m256i b2 = _mm256_loadu_si256((const __m256i *)(p + 67));
+    uint32_t m0 = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a0, b0));
+    uint32_t m1 = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a1, b1));
+    uint32_t m2 = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a2, b2));
+    *lo = (uint64_t)m0 | ((uint64_t)m1 << 32);
+    *hi = (uint64_t)m2 | ~0xFFFFFFFFull;
+}
+#elif defined(__SSE2__)
+#define REPEAT_BLOCK 16
+// bit i set <=> p[i] == p[i + 3] for i in [0, 48)
+// bits past 48 are set so only real mismatches show up
+static inline void repeat_mask(const unsigned char *p, uint64_t *lo, uint64_t *hi) {
+    __m128i a0 = _mm_loadu_si128((const __m128i *)(p));
+    __m128i a1 = _mm_loadu_si128((const __m128i *)(p + 16));
+    __m128i a2 = _mm_loadu_si128((const __m128i *)(p + 32));
+    __m128i b0 = _mm_loadu_si128((const __m128i *)(p + 3));
+    __m128i b1 = _mm_loadu_si128((const __m128i *)(p + 19));
+    __m128i b2 = _mm_loadu_si128((const __m128i *)(p + 35));
+    uint64_t m0 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a0, b0));
+    uint64_t m1 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a1, b1));
+    uint64_t m2 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a2, b2));
+    *lo = m0 | (m1 << 16) | (m2 << 32) | ~0xFFFFFFFFFFFFull;
+    *hi = ~0ull;
+}
+#endif
+
+// how many of the n cells after (top, bot) have the same colors
+// cells that repeat the previous one need no color codes => glyph only
+static inline int count_repeats(const unsigned char *top, const unsigned char *bot, int n) {
+    int count = 0;
+
+    // cheap scalar reject first, most cells in busy frames differ
+    if (n == 0 || memcmp(top, top + 3, 3) != 0 || memcmp(bot, bot + 3, 3) != 0) {
+        return 0;
+    }
+
+#ifdef REPEAT_BLOCK
+    // REPEAT_BLOCK cells per step, reads stay inside [top, top + 3 + 3n)
+    while (n - count >= REPEAT_BLOCK) {
+        uint64_t top_lo, top_hi, bot_lo, bot_hi;
+        repeat_mask(top + count * 3, &top_lo, &top_hi);
+        repeat_mask(bot + count * 3, &bot_lo, &bot_hi);
+
+        uint64_t lo = ~(top_lo & bot_lo);
+        uint64_t hi = ~(top_hi & bot_hi);
+        if (lo == 0 && hi == 0) {
+            count += REPEAT_BLOCK;
+            continue;
+        }
+
+        // first differing byte => whole cells before it repeat
+        int first = lo ? __builtin_ctzll(lo) : 64 + __builtin_ctzll(hi);
+        return count + first / 3;
+    }
+#endif
+
+    while (count < n) {
+        const unsigned char *t = top + count * 3;
+        const unsigned char *b = bot + count * 3;
+        if (t[0] != t[3] || t[1] != t[4] || t[2] != t[5] ||
+            b[0] != b[3] || b[1] != b[4] || b[2] != b[5]) {
+            break;
+        }
+        count++;
+    }
+    return count;
+}
+
+// fast int to string, returns chars written
+static inline int fast_uint_to_str(unsigned int val, char *buf) {
+    char tmp[10];
+    int len = 0;
+    do {
+        tmp[len++] = '0' + (val % 10);
+        val /= 10;
+    } while (val);
+    for (int i = 0; i < len; i++) {
+        buf[i] = tmp[len - 1 - i];
+    }
+    return len;
+}
+
+// "\033[n" + final, cursor moves / REP / ECH
+static inline char* emit_csi_count(char *buf, int n, char final) {
+    *buf++ = '\033';
+    *buf++ = '[';
+    buf += fast_uint_to_str(n, buf);
+    *buf++ = final;
+    return buf;
+}
+
+// "\033[nC"
+static inline char* emit_cursor_forward(char *buf, int n) {
+    return emit_csi_count(buf, n, 'C');
+}
+
+// background sgr only (if needed), for erased runs
+static inline char* emit_background(char *buf, ColorState *state, ColorMode mode, const unsigned char *lut,
+                                    const Lossy *lossy, const unsigned char *top) {
+    if (lut) {
+        uint32_t bg = lut[LUT_INDEX(top)];
+        if (bg == state->bg) return buf;
+        if (mode == COLOR_MODE_16) {
+            *buf++ = '\033';
+            *buf++ = '[';
+            memcpy(buf, SGR16_BG[bg], 4);
+            buf += bg < 8 ? 2 : 3;
+        } else {
+            memcpy(buf, SGR_BG_256, 8);
+            buf = put_u8(buf + 7, bg);
+        }
+        *buf++ = 'm';
+        state->bg = bg;
+        return buf;
+    }
+
+    unsigned char top_snapped[3];
+    if (lossy->snap_mask != 0xFF) {
+        for (int c = 0; c < 3; c++) {
+            top_snapped[c] = (top[c] & lossy->snap_mask) | lossy->snap_half;
+        }
+        top = top_snapped;
+    }
+    uint32_t bg = pack_rgb(top);
+    if (colors_close(bg, state->bg, lossy->tolerance_sq)) return buf;
+
+    memcpy(buf, SGR_BG, 8);
+    buf = put_rgb(buf + 7, top);
+    *buf++ = 'm';
+    state->bg = bg;
+    return buf;
+}
+
+// shorter runs are cheaper as plain glyphs / a redrawn cell
+// "\033[nb" is 4+ bytes, the glyphs it replaces 1-4 bytes each
+#define REP_MIN_BYTES 5
+#define ECH_MIN_RUN 3
+
+struct FrameEncoder {
+    EncodeOptions options;
+
+    // resolved from options once
+    const unsigned char *lut;  // NULL => truecolor
+    const Glyph *glyphs;       // NULL => half blocks
+    Lossy lossy;
+
+    // black row standing in for pixel rows missing at the bottom of the last
+    // character row (odd height frames in half block mode)
+    // allocated before band workers start, they only read it
+    unsigned char *zero_row;
+    int zero_row_width;
+
+    // glyph mode cells fitted from the pixels, grown as needed
+    unsigned char *fitted_cells;
+    size_t fitted_size;
+
+    // previous frame for delta mode, the cells as last drawn
+    // per character row: bg (cols * 3), fg (cols * 3), masks (cols, glyph
+    // modes only)
+    unsigned char *prev_cells;
+    int prev_cols;
+    int prev_rows;
+
+    // screen cell of the frame's top left corner
+    int origin_row;
+    int origin_col;
+
+    // options.threads - 1 band workers, started with the encoder
+    WorkerPool *pool;
+};
+
+// cells [x0, x1) of one character row, cursor already at x0
+// cells with the same rgb share a palette entry too, so repeats hold in
+// every color mode
+// with run_length_flags, runs of one cell repeated go out as the cell +
+// REP, and runs whose top and bottom match as background + ECH, which
+// skips the fg sgr but leaves the cursor at the start of the run
+// *cursor_out: column the cursor ends up at, <= x1
+static char* encode_span(char *buf, ColorState *state, const FrameEncoder *encoder, const CellRow *cells,
+                         int x0, int x1, int *cursor_out) {
+    ColorMode mode = encoder->options.color_mode;
+    int run_length_flags = encoder->options.run_length_flags;
+    const unsigned char *lut = encoder->lut;
+    const Glyph *glyphs = cells->masks ? encoder->glyphs : NULL;
+    const Lossy *lossy = &encoder->lossy;
+    int x = x0;
+    int cursor = x0;
+    while (x < x1) {
+        const unsigned char *t = cells->bg + x * 3;
+        const unsigned char *b = cells->fg + x * 3;
+        int mask = glyphs ? cells->masks[x] : 0;
+        int repeats = count_repeats(t, b, x1 - x - 1);
+        if (glyphs) {
+            int same = 0;
+            while (same < repeats && cells->masks[x + 1 + same] == mask) same++;
+            repeats = same;
+        }
+        int run = repeats + 1;
+
+        // erase instead of draw when only the background is needed: at the
+        // end of the span (no cursor move back) or when the fg would change
+        // one color glyph cells are a space, which never needs the fg
+        if ((run_length_flags & RUN_ECH) && run >= ECH_MIN_RUN &&
+            (lut ? lut[LUT_INDEX(t)] == lut[LUT_INDEX(b)] : memcmp(t, b, 3) == 0)) {
+            uint32_t fg = lut ? lut[LUT_INDEX(b)] : pack_rgb(b);
+            int at_end = x + run == x1;
+            if (at_end || (!glyphs && (lut ? fg != state->fg : !colors_close(fg, state->fg, lossy->tolerance_sq)))) {
+                if (cursor < x) {
+                    buf = emit_cursor_forward(buf, x - cursor);
+                }
+                buf = emit_background(buf, state, mode, lut, lossy, t);
+                buf = emit_csi_count(buf, run, 'X');
+                cursor = x;
+                x += run;
+                continue;
+            }
+        }
+
+        if (cursor < x) {
+            buf = emit_cursor_forward(buf, x - cursor);
+        }
+        if (glyphs && mask == 0) {
+            buf = emit_background(buf, state, mode, lut, lossy, t);
+        } else {
+            buf = lut ? emit_palette_colors(buf, state, mode, lut, t, b) : emit_colors(buf, state, lossy, t, b);
+        }
+        int glyph_len = glyphs ? glyphs[mask].len : 3;
+        memcpy(buf, glyphs ? glyphs[mask].s : glyph_run, 4);
+        buf += glyph_len;
+
+        if ((run_length_flags & RUN_REP) && repeats * glyph_len >= REP_MIN_BYTES) {
+            buf = emit_csi_count(buf, repeats, 'b');
+        } else if (!glyphs) {
+            buf = emit_glyphs(buf, repeats);
+        } else {
+            for (int i = 0; i < repeats; i++) {
+                memcpy(buf, glyphs[mask].s, 4);
+                buf += glyph_len;
+            }
+        }
+        x += run;
+        cursor = x;
+    }
+    *cursor_out = cursor;
+    return buf;
+}
+
+// "\033[row;colH" 1-based
+static inline char* emit_cursor_to(char *buf, int row, int col) {
+    *buf++ = '\033';
+    *buf++ = '[';
+    buf += fast_uint_to_str(row + 1, buf);
+    *buf++ = ';';
+    buf += fast_uint_to_str(col + 1, buf);
+    *buf++ = 'H';
+    return buf;
+}
+
+static int prepare_zero_row(FrameEncoder *encoder, int width) {
+    if (encoder->zero_row_width < width) {
+        free(encoder->zero_row);
+        encoder->zero_row = calloc(width, 3);
+        encoder->zero_row_width = encoder->zero_row ? width : 0;
+    }
+    return encoder->zero_row != NULL;
+}
+
+// bg, fg, mask per cell
+#define CELL_BYTES 7
+
+// a frame as character rows of cells
+typedef struct {
+    FrameEncoder *encoder;
+    const unsigned char *pixels;
+    int width;   // pixels
+    int height;
+    int stride;
+    int cell_width;   // pixels per cell
+    int cell_height;
+    int cols;
+    int rows;
+    unsigned char *fitted;  // glyph modes: per row bg | fg | masks, NULL => half blocks
+} CellFrame;
+
+static inline const unsigned char* pixel_row(const CellFrame *frame, int y) {
+    return y < frame->height ? frame->pixels + y * frame->stride : frame->encoder->zero_row;
+}
+
+// 0 => nothing to encode (empty frame or allocation failure)
+static int prepare_cell_frame(FrameEncoder *encoder, CellFrame *frame, const unsigned char *pixels,
+                              int width, int height, int stride) {
+    frame->encoder = encoder;
+    frame->pixels = pixels;
+    frame->width = width;
+    frame->height = height;
+    frame->stride = stride;
+    glyph_cell_size(encoder->options.glyph_mode, &frame->cell_width, &frame->cell_height);
+    // a partial last column is dropped, missing rows at the bottom are black
+    frame->cols = width / frame->cell_width;
+    frame->rows = (height + frame->cell_height - 1) / frame->cell_height;
+    frame->fitted = NULL;
+
+    if (frame->cols == 0 || frame->rows == 0) return 0;
+    if (height % frame->cell_height && !prepare_zero_row(encoder, width)) return 0;
+
+    if (encoder->glyphs) {
+        size_t size = (size_t)frame->rows * frame->cols * CELL_BYTES;
+        if (encoder->fitted_size < size) {
+            free(encoder->fitted_cells);
+            encoder->fitted_cells = malloc(size);
+            encoder->fitted_size = encoder->fitted_cells ? size : 0;
+            if (!encoder->fitted_cells) return 0;
+        }
+        frame->fitted = encoder->fitted_cells;
+    }
+    return 1;
+}
+
+static inline CellRow cell_row(const CellFrame *frame, int row) {
+    CellRow cells;
+    if (!frame->fitted) {
+        int y = row * 2;
+        cells.bg = frame->pixels + y * frame->stride;
+        cells.fg = pixel_row(frame, y + 1);
+        cells.masks = NULL;
+    } else {
+        const unsigned char *base = frame->fitted + (size_t)row * frame->cols * CELL_BYTES;
+        cells.bg = base;
+        cells.fg = base + frame->cols * 3;
+        cells.masks = base + frame->cols * 6;
+    }
+    return cells;
+}
+
+// glyph modes: pixels => bg, fg and mask for every cell of rows [row0, row1)
+static void fit_rows(const CellFrame *frame, int row0, int row1) {
+    int n = frame->cell_width * frame->cell_height;
+
+    for (int row = row0; row < row1; row++) {
+        unsigned char *bg = frame->fitted + (size_t)row * frame->cols * CELL_BYTES;
+        unsigned char *fg = bg + frame->cols * 3;
+        unsigned char *masks = bg + frame->cols * 6;
+
+        const unsigned char *lines[4];
+        for (int i = 0; i < frame->cell_height; i++) {
+            lines[i] = pixel_row(frame, row * frame->cell_height + i);
+        }
+
+        for (int col = 0; col < frame->cols; col++) {
+            unsigned char px[8][3];
+            int x = col * frame->cell_width;
+            for (int i = 0; i < n; i++) {
+                memcpy(px[i], lines[i / frame->cell_width] + (x + i % frame->cell_width) * 3, 3);
+            }
+            fit_cell(px, n, bg + col * 3, fg + col * 3, &masks[col]);
+        }
+    }
+}
+
+// returns 1 if prev_cells is usable for a delta against this frame
+static int prepare_prev_cells(FrameEncoder *encoder, const CellFrame *frame) {
+    if (encoder->prev_cells && encoder->prev_cols == frame->cols && encoder->prev_rows == frame->rows) {
+        return 1;
+    }
+
+    free(encoder->prev_cells);
+    encoder->prev_cells = malloc((size_t)frame->rows * frame->cols * CELL_BYTES);
+    encoder->prev_cols = encoder->prev_cells ? frame->cols : 0;
+    encoder->prev_rows = encoder->prev_cells ? frame->rows : 0;
+    return 0;
+}
+
+void frame_encoder_reset_delta(FrameEncoder *encoder) {
+    // prepare_prev_cells sees a size mismatch and starts over
+    encoder->prev_cols = 0;
+    encoder->prev_rows = 0;
+}
+
+void frame_encoder_set_origin(FrameEncoder *encoder, int row, int col) {
+    if (row != encoder->origin_row || col != encoder->origin_col) {
+        encoder->origin_row = row;
+        encoder->origin_col = col;
+        frame_encoder_reset_delta(encoder);
+    }
+}
+
+static inline CellRow prev_row(const CellFrame *frame, int row) {
+    unsigned char *base = frame->encoder->prev_cells + (size_t)row * frame->cols * CELL_BYTES;
+    CellRow cells = {base, base + frame->cols * 3, frame->fitted ? base + frame->cols * 6 : NULL};
+    return cells;
+}
+
+// cells [x0, x1) of a row into the previous frame
+static void store_cells(const CellFrame *frame, unsigned char *base, const CellRow *cells, int x0, int x1) {
+    memcpy(base + x0 * 3, cells->bg + x0 * 3, (x1 - x0) * 3);
+    memcpy(base + frame->cols * 3 + x0 * 3, cells->fg + x0 * 3, (x1 - x0) * 3);
+    if (cells->masks) {
+        memcpy(base + frame->cols * 6 + x0, cells->masks + x0, x1 - x0);
+    }
+}
+
+// lossy => small changes don't count
+// prev holds the source colors of the last redraw, not the reused active
+// colors encode_span drew: those are up to tolerance per channel off the
+// source, a skip up to tolerance more => the screen at most 2x tolerance
+static inline int cell_unchanged(const CellRow *prev, const CellRow *cells, int x, int tolerance_sq) {
+    return pixels_close(prev->bg + x * 3, cells->bg + x * 3, tolerance_sq) &&
+           pixels_close(prev->fg + x * 3, cells->fg + x * 3, tolerance_sq) &&
+           (!cells->masks || prev->masks[x] == cells->masks[x]);
+}
+
+// character rows [row0, row1), colors start from unknown
+static char* render_full(const CellFrame *frame, char *buf, unsigned char *cells_out, int row0, int row1) {
+    ColorState state;
+    const FrameEncoder *encoder = frame->encoder;
+    int placed = encoder->origin_row || encoder->origin_col;
+
+    // cursor pos reset "\033[H"
+    if (row0 == 0 && !placed) {
+        *buf++ = '\033';
+        *buf++ = '[';
+        *buf++ = 'H';
+    }
+
+    // bands are encoded independently => no color carried in from the band above
+    // within the band colors carry across rows, the newline keeps sgr state
+    reset_color_state(&state);
+
+    for(int row = row0; row < row1; row++){
+        CellRow cells = cell_row(frame, row);
+        int cursor_x;
+
+        // away from the top left a newline would land in column 0 =>
+        // every row is positioned
+        if (placed) {
+            buf = emit_cursor_to(buf, encoder->origin_row + row, encoder->origin_col);
+        }
+
+        // a trailing erased run leaves the cursor short of the row end,
+        // the newline (cr + lf through the tty) doesn't care
+        buf = encode_span(buf, &state, frame->encoder, &cells, 0, frame->cols, &cursor_x);
+
+        if (cells_out) {
+            store_cells(frame, cells_out + (size_t)row * frame->cols * CELL_BYTES, &cells, 0, frame->cols);
+        }
+
+        if (row + 1 < frame->rows && !placed) {
+            *buf++ = '\n';
+        }
+    }
+
+    return buf;
+}
+
+// only changed cells, jumping the cursor over unchanged spans
+// 1 cell gaps are cheaper to redraw (3 bytes) than to jump (4+ bytes)
+static char* render_delta(const CellFrame *frame, char *buf, int row0, int row1) {
+    ColorState state;
+    int tolerance_sq = frame->encoder->lossy.tolerance_sq;
+    int width = frame->cols;
+
+    reset_color_state(&state);
+
+    for(int row = row0; row < row1; row++){
+        CellRow cells = cell_row(frame, row);
+        CellRow prev = prev_row(frame, row);
+        unsigned char *prev_base = frame->encoder->prev_cells + (size_t)row * width * CELL_BYTES;
+        int cursor_x = -1;  // column the cursor sits at in this row, -1 => elsewhere
+
+        int x = 0;
+        while (x < width) {
+            if (cell_unchanged(&prev, &cells, x, tolerance_sq)) {
+                x++;
+                continue;
+            }
+
+            // extend the changed run across 1 cell gaps
+            int end = x + 1;
+            while (end < width) {
+                if (!cell_unchanged(&prev, &cells, end, tolerance_sq)) {
+                    end++;
+                } else if (end + 1 < width && !cell_unchanged(&prev, &cells, end + 1, tolerance_sq)) {
+                    end += 2;
+                } else {
+                    break;
+                }
+            }
+
+            if (cursor_x < 0) {
+                buf = emit_cursor_to(buf, frame->encoder->origin_row + row, frame->encoder->origin_col + x);
+            } else if (x > cursor_x) {
+                buf = emit_cursor_forward(buf, x - cursor_x);
+            }
+
+            // a trailing erased run leaves the cursor behind end, the next
+            // jump just gets longer
+            buf = encode_span(buf, &state, frame->encoder, &cells, x, end, &cursor_x);
+            store_cells(frame, prev_base, &cells, x, end);
+
+            x = end;
+        }
+    }
+
+    return buf;
+}
+// worst case bytes of one band, cols cells wide
+static size_t band_capacity(int cols) {
+    // worst case per cell is both colors change:
+    //   "\033[38;2;RRR;GGG;BBB;48;2;RRR;GGG;BBBm▄"
+    //   max is 3 + 18 + 18 + 1 + 3 = 43 bytes (44 with a 4 byte sextant)
+    // color state tracking => most cells skip color codes entirely
+    // delta mode adds at most one cursor jump "\033[RRRR;CCCCH" (12 bytes)
+    // per two cells since 1 cell gaps get redrawn instead of jumped
+    // for each row:
+    //   newline 1 byte, or a cursor jump (12 bytes) with an origin
+    //   "\033[H" (3 bytes) to reset cursor position
+    // fixed width stores write up to 4 bytes past the end
+    return 3 + (size_t)ENCODE_BAND_ROWS * (cols * 50 + 12) + 4;
+}
+
+FrameEncoder* frame_encoder_create(const EncodeOptions *options) {
+    FrameEncoder *encoder = calloc(1, sizeof(FrameEncoder));
+    if (!encoder) return NULL;
+
+    encoder->options = *options;
+    if (encoder->options.threads < 1) encoder->options.threads = 1;
+    encoder->lut = palette_lut(options->color_mode);
+    encoder->glyphs = glyph_table(options->glyph_mode);
+    encoder->lossy = lossy_settings(options);
+    encoder->pool = worker_pool_create(encoder->options.threads);
+    if (!encoder->pool) {
+        free(encoder);
+        return NULL;
+    }
+    return encoder;
+}
+
+void frame_encoder_free(FrameEncoder *encoder) {
+    if (!encoder) return;
+
+    worker_pool_free(encoder->pool);
+    free(encoder->zero_row);
+    free(encoder->fitted_cells);
+    free(encoder->prev_cells);
+    free(encoder);
+}
+
+const EncodeOptions* frame_encoder_options(const FrameEncoder *encoder) {
+    return &encoder->options;
+}
+
+int frame_encoder_band_count(const FrameEncoder *encoder, int height) {
+    int cell_width, cell_height;
+    glyph_cell_size(encoder->options.glyph_mode, &cell_width, &cell_height);
+    int rows = (height + cell_height - 1) / cell_height;
+    return (rows + ENCODE_BAND_ROWS - 1) / ENCODE_BAND_ROWS;
+}
+
+size_t frame_encoder_buffer_size(const FrameEncoder *encoder, int width, int height) {
+    // every band gets its own fixed slice => workers never share bytes
+    int cell_width, cell_height;
+    glyph_cell_size(encoder->options.glyph_mode, &cell_width, &cell_height);
+    int bands = frame_encoder_band_count(encoder, height);
+    return (size_t)(bands > 0 ? bands : 1) * band_capacity(width / cell_width);
+}
+// a worker's share of the bands
+typedef struct {
+    const CellFrame *frame;
+    char *frame_buffer;
+    int fit;                   // fit_rows only, nothing encoded
+    int delta;                 // render_delta instead of render_full
+    unsigned char *cells_out;  // render_full only, NULL => don't record
+    int band_begin;
+    int band_end;
+    size_t *lens;              // bytes written per band
+} EncodeJob;
+
+static void encode_bands(void *arg, int share) {
+    EncodeJob *job = (EncodeJob *)arg + share;
+    const CellFrame *frame = job->frame;
+    size_t capacity = band_capacity(frame->cols);
+
+    for (int band = job->band_begin; band < job->band_end; band++) {
+        int row0 = band * ENCODE_BAND_ROWS;
+        int row1 = row0 + ENCODE_BAND_ROWS < frame->rows ? row0 + ENCODE_BAND_ROWS : frame->rows;
+        if (job->fit) {
+            fit_rows(frame, row0, row1);
+            continue;
+        }
+        char *start = job->frame_buffer + band * capacity;
+        char *end = job->delta
+            ? render_delta(frame, start, row0, row1)
+            : render_full(frame, start, job->cells_out, row0, row1);
+        job->lens[band] = end - start;
+    }
+}
+
+// bands split evenly over the encoder's threads, the first share runs on the
+// calling thread and the pool's workers take the rest
+static void run_encode(const CellFrame *frame, char *frame_buffer, int fit,
+                       int delta, unsigned char *cells_out, size_t *lens) {
+    int bands = (frame->rows + ENCODE_BAND_ROWS - 1) / ENCODE_BAND_ROWS;
+    int threads = frame->encoder->options.threads;
+    if (threads > bands) threads = bands;
+    if (threads < 1) threads = 1;
+
+    EncodeJob jobs[threads];
+    for (int t = 0; t < threads; t++) {
+        jobs[t].frame = frame;
+        jobs[t].frame_buffer = frame_buffer;
+        jobs[t].fit = fit;
+        jobs[t].delta = delta;
+        jobs[t].cells_out = cells_out;
+        jobs[t].band_begin = t * bands / threads;
+        jobs[t].band_end = (t + 1) * bands / threads;
+        jobs[t].lens = lens;
+    }
+    worker_pool_run(frame->encoder->pool, encode_bands, jobs, threads);
+}
+
+size_t frame_encoder_encode_bands(FrameEncoder *encoder, const unsigned char *pixels, int width, int height,
+                                  int stride, char *frame_buffer, struct iovec *bands, int *band_count) {
+    int count = frame_encoder_band_count(encoder, height);
+    *band_count = 0;
+
+    CellFrame frame;
+    if (count == 0 || !prepare_cell_frame(encoder, &frame, pixels, width, height, stride)) {
+        return 0;
+    }
+
+    // glyph modes fit every cell first, delta mode compares fitted cells
+    if (frame.fitted) {
+        run_encode(&frame, frame_buffer, 1, 0, NULL, NULL);
+    }
+
+    int delta = 0;
+    unsigned char *cells_out = NULL;
+
+    if (encoder->options.delta) {
+        if (!prepare_prev_cells(encoder, &frame)) {
+            // no usable previous frame => full repaint
+            cells_out = encoder->prev_cells;
+        } else {
+            // count changed cells to choose between delta and full repaint
+            int total_cells = frame.rows * frame.cols;
+            int tolerance_sq = encoder->lossy.tolerance_sq;
+            int changed = 0;
+            for(int row = 0; row < frame.rows; row++){
+                CellRow cells = cell_row(&frame, row);
+                CellRow prev = prev_row(&frame, row);
+
+                // whole row unchanged is the common case for static footage
+                if (memcmp(prev.bg, cells.bg, frame.cols * 3) == 0 &&
+                    memcmp(prev.fg, cells.fg, frame.cols * 3) == 0 &&
+                    (!cells.masks || memcmp(prev.masks, cells.masks, frame.cols) == 0)) {
+                    continue;
+                }
+                for(int x = 0; x < frame.cols; x++){
+                    changed += !cell_unchanged(&prev, &cells, x, tolerance_sq);
+                }
+            }
+
+            if (changed == 0) {
+                return 0;
+            }
+
+            if ((float)changed / (float)total_cells > encoder->options.delta_threshold) {
+                cells_out = encoder->prev_cells;
+            } else {
+                delta = 1;
+            }
+        }
+    }
+
+    size_t lens[count];
+    run_encode(&frame, frame_buffer, 0, delta, cells_out, lens);
+
+    // delta bands with no changed cells are left out
+    size_t capacity = band_capacity(frame.cols);
+    size_t total = 0;
+    for (int band = 0; band < count; band++) {
+        if (lens[band] == 0) continue;
+        bands[*band_count].iov_base = frame_buffer + band * capacity;
+        bands[*band_count].iov_len = lens[band];
+        (*band_count)++;
+        total += lens[band];
+    }
+    return total;
+}
+
+size_t frame_encoder_encode(FrameEncoder *encoder, const unsigned char *pixels, int width, int height,
+                            int stride, char *frame_buffer) {
+    int count = frame_encoder_band_count(encoder, height);
+    struct iovec bands[count > 0 ? count : 1];
+    int band_count;
+
+    size_t total = frame_encoder_encode_bands(encoder, pixels, width, height, stride, frame_buffer,
+                                              bands, &band_count);
+
+    // close the gaps between band slices, the first band already sits at 0
+    char *buf = frame_buffer;
+    for (int i = 0; i < band_count; i++) {
+        memmove(buf, bands[i].iov_base, bands[i].iov_len);
+        buf += bands[i].iov_len;
+    }
+    return total;
+}
@@ -0,0 +1,122 @@
+#ifndef PIXIR_H
+#define PIXIR_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+// escape sequences used for cell colors
+// palette modes map every pixel through a 32x32x32 nearest color table
+typedef enum {
+    COLOR_MODE_TRUECOLOR,  // 38;2;r;g;b
+    COLOR_MODE_256,        // 38;5;n, 6x6x6 cube + gray ramp
+    COLOR_MODE_16          // 30-37 / 90-97
+} ColorMode;
+
+// palette entry mode maps an rgb pixel to, -1 => truecolor
+int palette_index(ColorMode mode, const unsigned char *rgb);
+
+// glyphs cells are drawn with, each covers a block of pixels
+// glyph modes fit two colors per cell and pick the glyph whose shape
+// matches which pixels are closer to which color
+typedef enum {
+    GLYPH_HALF,      // 1x2, lower half block, fg bottom / bg top, no fitting
+    GLYPH_QUADRANT,  // 2x2 quadrant blocks
+    GLYPH_SEXTANT,   // 2x3, needs a font with symbols for legacy computing
+    GLYPH_BRAILLE    // 2x4 braille dots in the fg over the bg
+} GlyphMode;
+
+// pixels per cell in mode, frames are encoded from cols * width by
+// rows * height pixels
+void glyph_cell_size(GlyphMode mode, int *width, int *height);
+
+// largest box with the source's aspect inside available_width x available_height
+void fit_aspect(int width, int height, int available_width, int available_height,
+                int *fit_width, int *fit_height);
+
+// pixels of the mode's glyph grid a width x height source is scaled to so
+// it fits cols x rows cells with its aspect kept (cells twice as tall as wide)
+void glyph_grid_size(GlyphMode mode, int width, int height, int cols, int rows,
+                     int *scaled_width, int *scaled_height);
+
+// run length escapes, only for terminals known to have them
+// RUN_REP: CSI n b repeats the glyph before it n times
+// RUN_ECH: CSI n X erases n cells to the active background, used for runs
+//   whose top and bottom colors match, needs background color erase
+// 0 => runs go out as plain glyphs
+#define RUN_REP 1
+#define RUN_ECH 2
+
+// frames are encoded in bands of ENCODE_BAND_ROWS character rows, each from
+// reset color state into its own slice of the frame buffer
+// => the same bytes come out whatever the thread count is
+#define ENCODE_BAND_ROWS 8
+
+typedef struct {
+    ColorMode color_mode;
+    GlyphMode glyph_mode;
+
+    // delta rendering => only redraw cells that changed since the last frame
+    // falls back to a full repaint when more than delta_threshold of cells changed
+    int delta;
+    float delta_threshold;
+
+    // lossy color tracking, trades color error for fewer escape bytes
+    // color_tolerance: a color close to the active fg / bg (weighted for
+    //   the eye, no channel more than this many levels off) reuses it, and
+    //   delta mode skips cells that changed less than that since their last
+    //   redraw => on screen a channel can be up to 2x this off, 0 => exact
+    // color_snap_bits: low bits dropped per channel before comparing, 0 => off
+    // snapping only applies to truecolor, palettes quantize anyway
+    int color_tolerance;
+    int color_snap_bits;
+
+    int run_length_flags;  // RUN_REP | RUN_ECH
+    int threads;           // bands encoded in parallel, 1 => calling thread only
+} EncodeOptions;
+
+// truecolor half blocks, no delta, lossless, no run length escapes, 1 thread
+void encode_default_options(EncodeOptions *options);
+
+// encoder state: the options plus the previous frame for delta mode and
+// scratch buffers, nothing is shared between encoders
+// one thread at a time per encoder, any number of encoders in parallel
+typedef struct FrameEncoder FrameEncoder;
+
+// starts options->threads - 1 band workers that live as long as the encoder
+// NULL on error
+FrameEncoder* frame_encoder_create(const EncodeOptions *options);
+
+// joins the band workers
+void frame_encoder_free(FrameEncoder *encoder);
+
+const EncodeOptions* frame_encoder_options(const FrameEncoder *encoder);
+
+// forget the previous frame, the next delta mode frame is a full repaint
+void frame_encoder_reset_delta(FrameEncoder *encoder);
+
+// screen cell (0-based) the frame's top left corner is drawn at, (0, 0)
+// by default, elsewhere every row is positioned instead of following a
+// newline => frames can share the screen with others
+// a new origin starts over with a full repaint
+void frame_encoder_set_origin(FrameEncoder *encoder, int row, int col);
+
+// bands a frame of the given pixel height is split into
+int frame_encoder_band_count(const FrameEncoder *encoder, int height);
+
+// worst case bytes an encode can produce for a width x height frame
+size_t frame_encoder_buffer_size(const FrameEncoder *encoder, int width, int height);
+
+// encode a frame of glyph cells into frame_buffer without writing it
+// pixels are RGB24 rows stride bytes apart, width x height pixels of the
+// glyph grid (see glyph_cell_size)
+// returns bytes used, 0 => nothing changed (delta mode)
+size_t frame_encoder_encode(FrameEncoder *encoder, const unsigned char *pixels, int width, int height,
+                            int stride, char *frame_buffer);
+
+// same, but bands stay where they were encoded, ready for one writev
+// bands needs room for frame_encoder_band_count(height) entries, empty
+// bands (delta mode) are left out of *band_count
+size_t frame_encoder_encode_bands(FrameEncoder *encoder, const unsigned char *pixels, int width, int height,
+                                  int stride, char *frame_buffer, struct iovec *bands, int *band_count);
+
+#endif
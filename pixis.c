@@ -0,0 +1,240 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "pixis.h"
+
+// column sums carry 4 u32 lanes per pixel read (rgb + next r), pad the tail
+#define SUMS_PAD 4
+
+// reciprocal of each box area in 8.24 fixed point => no divides per pixel
+#define RECIP_SHIFT 24
+
+typedef struct {
+    Scaler *scaler;
+    const unsigned char *src;
+    int src_stride;
+    unsigned char *dst;
+    int dst_stride;
+    int y_begin;
+    int y_end;
+    unsigned int *sums;
+} ScalerBand;
+
+static inline uint32_t reciprocal(int area) {
+    return (uint32_t)(((1ull << RECIP_SHIFT) + area / 2) / area);
+}
+
+// source span [start, start + count) for each of dst outputs
+// upscaling repeats a source pixel instead of producing empty spans
+static void compute_spans(int src, int dst, int *start, int *count) {
+    for (int i = 0; i < dst; i++) {
+        int s0 = (int)((int64_t)i * src / dst);
+        int s1 = (int)((int64_t)(i + 1) * src / dst);
+        if (s1 <= s0) s1 = s0 + 1;
+        if (s1 > src) s1 = src;
+        start[i] = s0;
+        count[i] = s1 - s0;
+    }
+}
+
+Scaler* scaler_create(int src_width, int src_height, int dst_width, int dst_height, int threads) {
+    if (src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0) {
+        return NULL;
+    }
+    if (threads < 1) threads = 1;
+    if (threads > dst_height) threads = dst_height;
+
+    Scaler *scaler = calloc(1, sizeof(Scaler));
+    if (!scaler) return NULL;
+
+    scaler->src_width = src_width;
+    scaler->src_height = src_height;
+    scaler->dst_width = dst_width;
+    scaler->dst_height = dst_height;
+    scaler->threads = threads;
+    scaler->x_start = malloc(dst_width * sizeof(int));
+    scaler->x_count = malloc(dst_width * sizeof(int));
+    scaler->y_start = malloc(dst_height * sizeof(int));
+    scaler->y_count = malloc(dst_height * sizeof(int));
+    scaler->sums = malloc((size_t)threads * (src_width * 3 + SUMS_PAD) * sizeof(unsigned int));
+    scaler->pool = worker_pool_create(threads);
+
+    if (!scaler->x_start || !scaler->x_count || !scaler->y_start || !scaler->y_count || !scaler->sums ||
+        !scaler->pool) {
+        scaler_free(scaler);
+        return NULL;
+    }
+
+    compute_spans(src_width, dst_width, scaler->x_start, scaler->x_count);
+    compute_spans(src_height, dst_height, scaler->y_start, scaler->y_count);
+
+    // spans are floor(src / dst) or one more, so each output row only ever
+    // needs the reciprocals of two box areas
+    int max_x = 0, max_y = 0;
+    scaler->x_count_min = scaler->x_count[0];
+    for (int i = 0; i < dst_width; i++) {
+        if (scaler->x_count[i] > max_x) max_x = scaler->x_count[i];
+        if (scaler->x_count[i] < scaler->x_count_min) scaler->x_count_min = scaler->x_count[i];
+    }
+    for (int i = 0; i < dst_height; i++) {
+        if (scaler->y_count[i] > max_y) max_y = scaler->y_count[i];
+    }
+
+    // a u32 sum of 255 * area must not overflow
+    if ((int64_t)max_x * max_y > (1 << 23)) {
+        scaler_free(scaler);
+        return NULL;
+    }
+
+    return scaler;
+}
+
+void scaler_free(Scaler *scaler) {
+    if (!scaler) return;
+
+    worker_pool_free(scaler->pool);
+    free(scaler->x_start);
+    free(scaler->x_count);
+    free(scaler->y_start);
+    free(scaler->y_count);
+    free(scaler->sums);
+    free(scaler);
+}
+
+// vertical pass: sums[i] += row[i] for i in [0, n)
+static inline void add_row(unsigned int *sums, const unsigned char *row, int n) {
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(row + i));
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+
+        __m128i *s = (__m128i *)(sums + i);
+        _mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), _mm_unpacklo_epi16(lo, zero)));
+        _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(lo, zero)));
+        _mm_storeu_si128(s + 2, _mm_add_epi32(_mm_loadu_si128(s + 2), _mm_unpacklo_epi16(hi, zero)));
+        _mm_storeu_si128(s + 3, _mm_add_epi32(_mm_loadu_si128(s + 3), _mm_unpackhi_epi16(hi, zero)));
+    }
+#endif
+    for (; i < n; i++) {
+        sums[i] += row[i];
+    }
+}
+
+static inline unsigned char scale_sum(uint32_t sum, uint32_t recip) {
+    uint32_t v = (uint32_t)(((uint64_t)sum * recip + (1u << (RECIP_SHIFT - 1))) >> RECIP_SHIFT);
+    return v > 255 ? 255 : (unsigned char)v;
+}
+
+// horizontal pass: average each output column's span of column sums
+static inline void average_row(const Scaler *scaler, const unsigned int *sums, int area_y, unsigned char *out) {
+    int count_min = scaler->x_count_min;
+    uint32_t recip_min = reciprocal(count_min * area_y);
+    uint32_t recip_max = reciprocal((count_min + 1) * area_y);
+
+    for (int x = 0; x < scaler->dst_width; x++) {
+        const unsigned int *s = sums + scaler->x_start[x] * 3;
+        int count = scaler->x_count[x];
+        uint32_t r = count == count_min ? recip_min : recip_max;
+
+#if defined(__SSE2__)
+        // lanes r g b (+ next r, ignored)
+        __m128i acc = _mm_loadu_si128((const __m128i *)s);
+        for (int i = 1; i < count; i++) {
+            acc = _mm_add_epi32(acc, _mm_loadu_si128((const __m128i *)(s + i * 3)));
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, acc);
+        out[x * 3 + 0] = scale_sum(lanes[0], r);
+        out[x * 3 + 1] = scale_sum(lanes[1], r);
+        out[x * 3 + 2] = scale_sum(lanes[2], r);
+#else
+        uint32_t sr = 0, sg = 0, sb = 0;
+        for (int i = 0; i < count; i++) {
+            sr += s[i * 3 + 0];
+            sg += s[i * 3 + 1];
+            sb += s[i * 3 + 2];
+        }
+        out[x * 3 + 0] = scale_sum(sr, r);
+        out[x * 3 + 1] = scale_sum(sg, r);
+        out[x * 3 + 2] = scale_sum(sb, r);
+#endif
+    }
+}
+
+static void scale_band(void *arg, int share) {
+    ScalerBand *band = (ScalerBand *)arg + share;
+    Scaler *scaler = band->scaler;
+    int n = scaler->src_width * 3;
+
+    for (int y = band->y_begin; y < band->y_end; y++) {
+        int y0 = scaler->y_start[y];
+        int count = scaler->y_count[y];
+
+        memset(band->sums, 0, (n + SUMS_PAD) * sizeof(unsigned int));
+        for (int i = 0; i < count; i++) {
+            add_row(band->sums, band->src + (y0 + i) * band->src_stride, n);
+        }
+
+        average_row(scaler, band->sums, count, band->dst + y * band->dst_stride);
+    }
+}
+
+void scaler_run(Scaler *scaler, const unsigned char *src, int src_stride, unsigned char *dst, int dst_stride) {
+    int threads = scaler->threads;
+    ScalerBand bands[threads];
+
+    for (int t = 0; t < threads; t++) {
+        bands[t].scaler = scaler;
+        bands[t].src = src;
+        bands[t].src_stride = src_stride;
+        bands[t].dst = dst;
+        bands[t].dst_stride = dst_stride;
+        bands[t].y_begin = (int)((int64_t)t * scaler->dst_height / threads);
+        bands[t].y_end = (int)((int64_t)(t + 1) * scaler->dst_height / threads);
+        bands[t].sums = scaler->sums + (size_t)t * (scaler->src_width * 3 + SUMS_PAD);
+    }
+
+    // band 0 runs on the calling thread, the pool's workers take the rest
+    worker_pool_run(scaler->pool, scale_band, bands, threads);
+}
+
+void scaler_stream_begin(Scaler *scaler) {
+    scaler->stream_row = 0;
+    scaler->stream_out = 0;
+    memset(scaler->sums, 0, (scaler->src_width * 3 + SUMS_PAD) * sizeof(unsigned int));
+}
+
+void scaler_stream_row(Scaler *scaler, const unsigned char *row, unsigned char *dst, int dst_stride) {
+    int n = scaler->src_width * 3;
+    int y = scaler->stream_row++;
+
+    if (scaler->stream_out >= scaler->dst_height) {
+        return;
+    }
+
+    // shrinking => spans partition the rows, growing => spans are one row
+    // and several outputs can repeat the same one
+    add_row(scaler->sums, row, n);
+    while (scaler->stream_out < scaler->dst_height) {
+        int out = scaler->stream_out;
+        if (scaler->y_start[out] + scaler->y_count[out] - 1 != y) {
+            break;
+        }
+
+        average_row(scaler, scaler->sums, scaler->y_count[out], dst + out * dst_stride);
+        scaler->stream_out++;
+
+        memset(scaler->sums, 0, (n + SUMS_PAD) * sizeof(unsigned int));
+        if (scaler->stream_out < scaler->dst_height && scaler->y_start[scaler->stream_out] == y) {
+            add_row(scaler->sums, row, n);
+        }
+    }
+}
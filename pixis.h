@@ -0,0 +1,42 @@
+#ifndef PIXIS_H
+#define PIXIS_H
+
+#include "pixip.h"
+
+// area averaging (box filter) RGB24 downscaler
+// source spans per output row/column are computed once per size change
+typedef struct {
+    int src_width;
+    int src_height;
+    int dst_width;
+    int dst_height;
+    int threads;         // output row bands run in parallel when > 1
+    int *x_start;        // first source column of each output column
+    int *x_count;        // source columns averaged per output column
+    int x_count_min;     // every x_count is this or one more
+    int *y_start;        // first source row of each output row
+    int *y_count;        // source rows averaged per output row
+    unsigned int *sums;  // per thread column sums, src_width * 3 + 4 each
+    int stream_row;      // streaming: next source row expected
+    int stream_out;      // streaming: next output row to complete
+    WorkerPool *pool;    // threads - 1 band workers, started once
+} Scaler;
+
+// starts threads - 1 band workers that live as long as the scaler
+// NULL on error
+Scaler* scaler_create(int src_width, int src_height, int dst_width, int dst_height, int threads);
+
+// joins the band workers
+void scaler_free(Scaler *scaler);
+
+// src is src_width x src_height, dst is dst_width x dst_height, RGB24 rows
+// stride bytes apart
+void scaler_run(Scaler *scaler, const unsigned char *src, int src_stride, unsigned char *dst, int dst_stride);
+
+// streaming: source rows arrive top to bottom one at a time, each output
+// row is written to dst as soon as its last source row has been pushed
+// => the source never has to be in memory as a whole
+void scaler_stream_begin(Scaler *scaler);
+void scaler_stream_row(Scaler *scaler, const unsigned char *row, unsigned char *dst, int dst_stride);
+
+#endif
@@ -0,0 +1,88 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include <errno.h>
+
+#include "pixit.h"
+
+// a decoder that can't keep up still shows every Nth frame instead of
+// dropping everything until the end
+#define MAX_DROP_RUN 4
+
+int64_t clock_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void clock_sleep_until_ns(int64_t deadline_ns) {
+    struct timespec ts;
+    ts.tv_sec = deadline_ns / 1000000000LL;
+    ts.tv_nsec = deadline_ns % 1000000000LL;
+
+    // absolute deadline => no drift from wakeup latency, restart on signals
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+void scheduler_init(FrameScheduler *scheduler, double fps) {
+    atomic_init(&scheduler->start_ns, 0);
+    scheduler->frame_ns = (int64_t)(1000000000.0 / (fps > 0 ? fps : 30.0));
+    // the frame still has to be scaled, encoded and written, so anything
+    // already a frame behind will only get worse
+    scheduler->drop_after_ns = scheduler->frame_ns;
+    scheduler->drop_run = 0;
+    atomic_init(&scheduler->dropped, 0);
+    atomic_init(&scheduler->late, 0);
+}
+
+static inline int64_t due_ns(int64_t start_ns, double pts) {
+    return start_ns + (int64_t)(pts * 1000000000.0);
+}
+
+int scheduler_should_drop(FrameScheduler *scheduler, double pts) {
+    int64_t start = atomic_load_explicit(&scheduler->start_ns, memory_order_acquire);
+    if (start == 0) {
+        return 0;
+    }
+
+    if (scheduler->drop_run < MAX_DROP_RUN && clock_now_ns() - due_ns(start, pts) > scheduler->drop_after_ns) {
+        scheduler->drop_run++;
+        atomic_fetch_add_explicit(&scheduler->dropped, 1, memory_order_relaxed);
+        return 1;
+    }
+    scheduler->drop_run = 0;
+    return 0;
+}
+
+void scheduler_reset(FrameScheduler *scheduler) {
+    atomic_store_explicit(&scheduler->start_ns, 0, memory_order_release);
+}
+
+int64_t scheduler_due_ns(FrameScheduler *scheduler, double pts) {
+    int64_t start = atomic_load_explicit(&scheduler->start_ns, memory_order_acquire);
+    if (start == 0) {
+        start = clock_now_ns() - (int64_t)(pts * 1000000000.0);
+        atomic_store_explicit(&scheduler->start_ns, start, memory_order_release);
+    }
+    return due_ns(start, pts);
+}
+
+void scheduler_wait(FrameScheduler *scheduler, double pts) {
+    int64_t now = clock_now_ns();
+    int64_t start = atomic_load_explicit(&scheduler->start_ns, memory_order_acquire);
+
+    if (start == 0) {
+        // first frame => pts maps to now
+        start = now - (int64_t)(pts * 1000000000.0);
+        atomic_store_explicit(&scheduler->start_ns, start, memory_order_release);
+        return;
+    }
+
+    int64_t due = due_ns(start, pts);
+    if (due > now) {
+        clock_sleep_until_ns(due);
+    } else if (now - due > scheduler->frame_ns) {
+        atomic_fetch_add_explicit(&scheduler->late, 1, memory_order_relaxed);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef PIXIT_H
+#define PIXIT_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// monotonic clock in nanoseconds
+int64_t clock_now_ns(void);
+
+// sleep until the monotonic clock reaches deadline_ns
+void clock_sleep_until_ns(int64_t deadline_ns);
+
+// wall clock playback against frame pts
+// the clock starts when the first frame is presented
+// decode side drops frames that can no longer make it, write side sleeps
+// until each frame is due
+typedef struct {
+    _Atomic int64_t start_ns;   // monotonic time of pts 0, 0 => not started
+    int64_t frame_ns;           // nominal frame duration
+    int64_t drop_after_ns;      // frames later than this are dropped before scaling
+    int drop_run;               // consecutive drops, decode side only
+    _Atomic int dropped;        // skipped before scale/encode
+    _Atomic int late;           // shown, but after their due time + frame_ns
+} FrameScheduler;
+
+void scheduler_init(FrameScheduler *scheduler, double fps);
+
+// decode side: 1 => skip this frame, it would be shown too late
+// counts the drop
+int scheduler_should_drop(FrameScheduler *scheduler, double pts);
+
+// restart the clock, the next frame presented defines pts => now again
+// (after a seek or pause), decode side drops nothing until then
+void scheduler_reset(FrameScheduler *scheduler);
+
+// write side: monotonic time the frame is due at (starting the clock on
+// the first frame), for callers that have other work while they wait
+int64_t scheduler_due_ns(FrameScheduler *scheduler, double pts);
+
+// write side: sleep until the frame is due (starting the clock on the first
+// frame), counts frames that are presented late
+void scheduler_wait(FrameScheduler *scheduler, double pts);
+
+#endif
@@ -7,7 +7,78 @@
 
 #include "pixiv.h"
 
+void video_decoder_default_options(VideoDecoderOptions *options) {
+    options->thread_count = 0;
+    options->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    options->lowres = 0;
+    options->skip_loop_filter = AVDISCARD_DEFAULT;
+    options->skip_frame = AVDISCARD_DEFAULT;
+    options->adaptive = 0;
+    options->target_width = 0;
+    options->target_height = 0;
+}
+
+// trade decode quality nobody will see for speed when the picture ends up
+// much smaller than the source
+static void apply_adaptive_options(AVCodecContext *codec_ctx, const AVCodec *codec,
+                                   const VideoDecoderOptions *options, int width, int height) {
+    if (options->target_width <= 0 || options->target_height <= 0) return;
+
+    // the frame is fitted inside the target, so the larger ratio is the shrink
+    double shrink_x = (double)width / options->target_width;
+    double shrink_y = (double)height / options->target_height;
+    double shrink = shrink_x > shrink_y ? shrink_x : shrink_y;
+
+    // deblocking is smoothed away by the downscale anyway
+    // skipping it on non reference frames keeps errors from propagating
+    if (shrink >= 2.0 && codec_ctx->skip_loop_filter < AVDISCARD_NONREF) {
+        codec_ctx->skip_loop_filter = AVDISCARD_NONREF;
+    }
+    if (shrink >= 4.0) {
+        if (codec_ctx->skip_loop_filter < AVDISCARD_ALL) {
+            codec_ctx->skip_loop_filter = AVDISCARD_ALL;
+        }
+        codec_ctx->flags2 |= AV_CODEC_FLAG2_FAST;
+    }
+
+    // lowres while the decoded frame stays at least 2x the target,
+    // only a few codecs (mjpeg, mpeg4 family) support it
+    int lowres = 0;
+    while (lowres < codec->max_lowres && shrink / (1 << (lowres + 1)) >= 2.0) {
+        lowres++;
+    }
+    if (lowres > codec_ctx->lowres) {
+        codec_ctx->lowres = lowres;
+    }
+}
+
+// appends only past the last known key frame, so the index stays sorted
+// and every packet read once the container's index is covered is one compare
+static void add_keyframe(VideoDecoder *decoder, int64_t ts) {
+    if (decoder->keyframe_count > 0 && ts <= decoder->keyframes[decoder->keyframe_count - 1]) {
+        return;
+    }
+    if (decoder->keyframe_count == decoder->keyframe_capacity) {
+        int capacity = decoder->keyframe_capacity ? decoder->keyframe_capacity * 2 : 256;
+        int64_t *keyframes = realloc(decoder->keyframes, capacity * sizeof(int64_t));
+        if (!keyframes) return;  // seeks fall back to the demuxer's own search
+        decoder->keyframes = keyframes;
+        decoder->keyframe_capacity = capacity;
+    }
+    decoder->keyframes[decoder->keyframe_count++] = ts;
+}
+
 VideoDecoder* video_decoder_open(const char *path) {
+    return video_decoder_open_with_options(path, NULL);
+}
+
+VideoDecoder* video_decoder_open_with_options(const char *path, const VideoDecoderOptions *options) {
+    VideoDecoderOptions defaults;
+    if (!options) {
+        video_decoder_default_options(&defaults);
+        options = &defaults;
+    }
+
     VideoDecoder *decoder = malloc(sizeof(VideoDecoder));
     if (!decoder) {
         fprintf(stderr, "Failed to allocate decoder\n");
@@ -17,10 +88,20 @@ VideoDecoder* video_decoder_open(const char *path) {
     decoder->codec_ctx = NULL;
     decoder->sws_ctx = NULL;
     decoder->frame = NULL;
-    decoder->rgb_frame = NULL;
+    decoder->rgb_pool = NULL;
     decoder->packet = NULL;
-    decoder->pixel_buffer = NULL;
     decoder->video_stream_index = -1;
+    decoder->out_width = 0;
+    decoder->out_height = 0;
+    decoder->out_stride = 0;
+    decoder->start_time = 0;
+    decoder->last_pts = 0.0;
+    decoder->draining = 0;
+    decoder->duration = 0.0;
+    decoder->keyframes = NULL;
+    decoder->keyframe_count = 0;
+    decoder->keyframe_capacity = 0;
+    decoder->seek_target = -1.0;
 
     int ret;
 
@@ -62,9 +143,34 @@ VideoDecoder* video_decoder_open(const char *path) {
             decoder->width = codec_params->width;
             decoder->height = codec_params->height;
 
-            // frame rate
-            AVRational frame_rate = decoder->format_ctx->streams[i]->avg_frame_rate;
-            decoder->fps = (double)frame_rate.num / (double)frame_rate.den;
+            // frame rate, some containers only know the base rate
+            AVStream *stream = decoder->format_ctx->streams[i];
+            AVRational frame_rate = stream->avg_frame_rate;
+            if (frame_rate.num <= 0 || frame_rate.den <= 0) {
+                frame_rate = stream->r_frame_rate;
+            }
+            decoder->fps = (frame_rate.num > 0 && frame_rate.den > 0)
+                ? (double)frame_rate.num / (double)frame_rate.den
+                : 30.0;
+
+            // timestamps => seconds from the first frame
+            decoder->time_base = stream->time_base;
+            decoder->start_time = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+
+            if (stream->duration > 0) {
+                decoder->duration = stream->duration * av_q2d(stream->time_base);
+            } else if (decoder->format_ctx->duration > 0) {
+                decoder->duration = (double)decoder->format_ctx->duration / AV_TIME_BASE;
+            }
+
+            // mp4 / mkv / ... carry the key frames in their index already
+            int entries = avformat_index_get_entries_count(stream);
+            for (int e = 0; e < entries; e++) {
+                const AVIndexEntry *entry = avformat_index_get_entry(stream, e);
+                if (entry && (entry->flags & AVINDEX_KEYFRAME)) {
+                    add_keyframe(decoder, entry->timestamp);
+                }
+            }
 
             break;
         }
@@ -92,6 +198,17 @@ VideoDecoder* video_decoder_open(const char *path) {
         return NULL;
     }
 
+    // threading + skip levels must be set before the codec opens
+    // thread_count 0 => FFmpeg picks one thread per core
+    decoder->codec_ctx->thread_count = options->thread_count;
+    decoder->codec_ctx->thread_type = options->thread_type;
+    decoder->codec_ctx->skip_loop_filter = options->skip_loop_filter;
+    decoder->codec_ctx->skip_frame = options->skip_frame;
+    decoder->codec_ctx->lowres = options->lowres < codec->max_lowres ? options->lowres : codec->max_lowres;
+    if (options->adaptive) {
+        apply_adaptive_options(decoder->codec_ctx, codec, options, decoder->width, decoder->height);
+    }
+
     // open the codec
     ret = avcodec_open2(decoder->codec_ctx, codec, NULL);
     if (ret < 0) {
@@ -100,6 +217,12 @@ VideoDecoder* video_decoder_open(const char *path) {
         return NULL;
     }
 
+    // lowres shrinks the frames the codec hands out
+    if (decoder->codec_ctx->lowres > 0) {
+        decoder->width = decoder->codec_ctx->width;
+        decoder->height = decoder->codec_ctx->height;
+    }
+
     // alloc decoded frames
     decoder->frame = av_frame_alloc();
     if (!decoder->frame) {
@@ -108,59 +231,76 @@ VideoDecoder* video_decoder_open(const char *path) {
         return NULL;
     }
 
-    // RGB conversion
-    decoder->rgb_frame = av_frame_alloc();
-    if (!decoder->rgb_frame) {
-        fprintf(stderr, "Could not allocate RGB frame\n");
+    // RGB conversion state (sws_ctx, rgb_pool) is built by
+    // video_decoder_set_output_size, or lazily at source resolution on the
+    // first frame so a terminal sized caller never allocates full size buffers
+
+    // data is compressed
+    decoder->packet = av_packet_alloc();
+    if (!decoder->packet) {
+        fprintf(stderr, "Could not allocate packet\n");
         video_decoder_close(decoder);
         return NULL;
     }
 
-    decoder->rgb_frame->format = AV_PIX_FMT_RGB24;
-    decoder->rgb_frame->width = decoder->width;
-    decoder->rgb_frame->height = decoder->height;
+    printf("  Resolution: %dx%d\n", codec_params->width, codec_params->height);
+    printf("  FPS: %.2f\n", decoder->fps);
+    printf("  Codec: %s\n", codec->name);
+    if (decoder->codec_ctx->lowres > 0) {
+        printf("  Lowres: 1/%d (%dx%d)\n", 1 << decoder->codec_ctx->lowres, decoder->width, decoder->height);
+    }
+
+    return decoder;
+}
 
-    ret = av_frame_get_buffer(decoder->rgb_frame, 0);
-    if (ret < 0) {
-        fprintf(stderr, "Could not allocate RGB frame buffer\n");
-        video_decoder_close(decoder);
-        return NULL;
+int video_decoder_set_output_size(VideoDecoder *decoder, int out_width, int out_height) {
+    if (!decoder || out_width <= 0 || out_height <= 0) return -1;
+
+    if (decoder->sws_ctx && out_width == decoder->out_width && out_height == decoder->out_height) {
+        return 0;
     }
 
-    // color space conversion
-    decoder->sws_ctx = sws_getContext(
+    // area averaging when shrinking, bilinear otherwise
+    int flags = (out_width < decoder->width || out_height < decoder->height) ? SWS_AREA : SWS_BILINEAR;
+
+    struct SwsContext *sws_ctx = sws_getContext(
         decoder->width, decoder->height, decoder->codec_ctx->pix_fmt,  // Source
-        decoder->width, decoder->height, AV_PIX_FMT_RGB24,             // Destination
-        SWS_BILINEAR, NULL, NULL, NULL
+        out_width, out_height, AV_PIX_FMT_RGB24,                       // Destination
+        flags, NULL, NULL, NULL
     );
-
-    if (!decoder->sws_ctx) {
+    if (!sws_ctx) {
         fprintf(stderr, "Could not create scaler context\n");
-        video_decoder_close(decoder);
-        return NULL;
+        return -1;
     }
 
-    // data is compressed
-    decoder->packet = av_packet_alloc();
-    if (!decoder->packet) {
-        fprintf(stderr, "Could not allocate packet\n");
-        video_decoder_close(decoder);
-        return NULL;
+    // rows padded to 32 bytes for swscale's simd stores
+    int out_stride = (out_width * 3 + 31) & ~31;
+
+    // frames are handed out as refs into this pool => no per frame
+    // allocation and no copy, buffers come back on video_frame_release
+    AVBufferPool *rgb_pool = av_buffer_pool_init(out_stride * out_height, av_buffer_alloc);
+    if (!rgb_pool) {
+        fprintf(stderr, "Could not allocate RGB frame pool\n");
+        sws_freeContext(sws_ctx);
+        return -1;
     }
 
-    // flat pixel buffer width * height * 3 bytes (RGB)
-    decoder->pixel_buffer = malloc(decoder->width * decoder->height * 3);
-    if (!decoder->pixel_buffer) {
-        fprintf(stderr, "Could not allocate pixel buffer\n");
-        video_decoder_close(decoder);
-        return NULL;
+    // swap in the new scaler state
+    // uninit only frees the old pool once every outstanding frame is released
+    if (decoder->sws_ctx) {
+        sws_freeContext(decoder->sws_ctx);
+    }
+    if (decoder->rgb_pool) {
+        av_buffer_pool_uninit(&decoder->rgb_pool);
     }
 
-    printf("  Resolution: %dx%d\n", decoder->width, decoder->height);
-    printf("  FPS: %.2f\n", decoder->fps);
-    printf("  Codec: %s\n", codec->name);
+    decoder->sws_ctx = sws_ctx;
+    decoder->rgb_pool = rgb_pool;
+    decoder->out_width = out_width;
+    decoder->out_height = out_height;
+    decoder->out_stride = out_stride;
 
-    return decoder;
+    return 0;
 }
 
 void video_decoder_close(VideoDecoder *decoder) {
@@ -169,18 +309,16 @@ void video_decoder_close(VideoDecoder *decoder) {
     if (decoder->packet) {
         av_packet_free(&decoder->packet);
     }
-    if (decoder->pixel_buffer) {
-        free(decoder->pixel_buffer);
-    }
     if (decoder->sws_ctx) {
         sws_freeContext(decoder->sws_ctx);
     }
-    if (decoder->rgb_frame) {
-        av_frame_free(&decoder->rgb_frame);
+    if (decoder->rgb_pool) {
+        av_buffer_pool_uninit(&decoder->rgb_pool);
     }
     if (decoder->frame) {
         av_frame_free(&decoder->frame);
     }
+    free(decoder->keyframes);
     if (decoder->codec_ctx) {
         avcodec_free_context(&decoder->codec_ctx);
     }
@@ -191,75 +329,173 @@ void video_decoder_close(VideoDecoder *decoder) {
     free(decoder);
 }
 
-unsigned char* video_decoder_next_frame(VideoDecoder *decoder) {
-    if (!decoder) return NULL;
+void video_frame_release(VideoFrame *frame) {
+    if (!frame) return;
+
+    if (frame->buf) {
+        av_buffer_unref(&frame->buf);
+    }
+    frame->data = NULL;
+}
+
+int video_decoder_decode(VideoDecoder *decoder, double *pts) {
+    if (!decoder) return 0;
 
     int ret;
 
-    // packet might be audio, subtitles, or video
-    // we only care about video rn
-    while (av_read_frame(decoder->format_ctx, decoder->packet) >= 0) {
-        // video packet
-        if (decoder->packet->stream_index == decoder->video_stream_index) {
-
-            // send packet to decoder
-            ret = avcodec_send_packet(decoder->codec_ctx, decoder->packet);
-            if (ret < 0) {
-                fprintf(stderr, "Warning: Packet decode error, skipping corrupted packet\n");
-                av_packet_unref(decoder->packet);
-                continue;  // bad packet go next
+    for (;;) {
+        // frames the codec already has buffered come first
+        ret = avcodec_receive_frame(decoder->codec_ctx, decoder->frame);
+        if (ret >= 0) {
+            int64_t ts = decoder->frame->best_effort_timestamp;
+            if (ts != AV_NOPTS_VALUE) {
+                decoder->last_pts = (ts - decoder->start_time) * av_q2d(decoder->time_base);
+            } else {
+                // no timestamp => assume constant frame rate
+                decoder->last_pts += 1.0 / decoder->fps;
             }
 
-            ret = avcodec_receive_frame(decoder->codec_ctx, decoder->frame);
-            if (ret == AVERROR(EAGAIN)) {
-                // need more packets to produce a frame
-                av_packet_unref(decoder->packet);
-                continue;
-            } else if (ret == AVERROR_EOF) {
-                // end of video
-                av_packet_unref(decoder->packet);
-                return NULL;
-            } else if (ret < 0) {
-                fprintf(stderr, "Warning: Frame receive error, skipping\n");
-                av_packet_unref(decoder->packet);
-                continue;  // bad frame go next
+            // decoding forward from the key frame to a seek target
+            // half a frame of slack so the frame at the target survives rounding
+            if (decoder->seek_target >= 0.0) {
+                if (decoder->last_pts < decoder->seek_target - 0.5 / decoder->fps) {
+                    continue;
+                }
+                decoder->seek_target = -1.0;
             }
-            // successfully got a frame => decode + color space conversion
+
+            if (pts) *pts = decoder->last_pts;
+            return 1;
+        } else if (ret == AVERROR_EOF) {
+            // end of video, every buffered frame delivered
+            return 0;
+        } else if (ret != AVERROR(EAGAIN)) {
+            fprintf(stderr, "Warning: Frame receive error, skipping\n");
+        }
+
+        if (decoder->draining) {
+            return 0;
+        }
+
+        // packet might be audio, subtitles, or video
+        // we only care about video rn
+        ret = av_read_frame(decoder->format_ctx, decoder->packet);
+        if (ret < 0) {
+            // eof => flush the frames still inside the codec
+            avcodec_send_packet(decoder->codec_ctx, NULL);
+            decoder->draining = 1;
+            continue;
+        }
+
+        if (decoder->packet->stream_index != decoder->video_stream_index) {
+            // not video packet
             av_packet_unref(decoder->packet);
+            continue;
+        }
 
-            // convert to RGB
-            sws_scale(
-                decoder->sws_ctx,
-                (const uint8_t * const*)decoder->frame->data,
-                decoder->frame->linesize,
-                0,
-                decoder->height,
-                decoder->rgb_frame->data,
-                decoder->rgb_frame->linesize
-            );
-
-            unsigned char *rgb_data = decoder->rgb_frame->data[0];
-            int linesize = decoder->rgb_frame->linesize[0];
-
-            // if linesize equals width*3 => no padding => fast memcpy whole thing
-            if (linesize == decoder->width * 3) {
-                memcpy(decoder->pixel_buffer, rgb_data, decoder->width * decoder->height * 3);
-            } else {
-                // handle padding => copy row by row
-                for (int y = 0; y < decoder->height; y++) {
-                    memcpy(decoder->pixel_buffer + y * decoder->width * 3,
-                           rgb_data + y * linesize,
-                           decoder->width * 3);
-                }
+        if (decoder->packet->flags & AV_PKT_FLAG_KEY) {
+            int64_t ts = decoder->packet->pts != AV_NOPTS_VALUE ? decoder->packet->pts : decoder->packet->dts;
+            if (ts != AV_NOPTS_VALUE) {
+                add_keyframe(decoder, ts);
             }
-
-            return decoder->pixel_buffer;
         }
 
-        // not video packet
+        // send packet to decoder
+        ret = avcodec_send_packet(decoder->codec_ctx, decoder->packet);
         av_packet_unref(decoder->packet);
+        if (ret < 0) {
+            fprintf(stderr, "Warning: Packet decode error, skipping corrupted packet\n");
+        }
     }
+}
+
+int video_decoder_seek(VideoDecoder *decoder, double seconds) {
+    if (!decoder) return -1;
+    if (seconds < 0.0) seconds = 0.0;
+
+    int64_t target = decoder->start_time + (int64_t)(seconds / av_q2d(decoder->time_base));
+
+    // last known key frame at or before the target
+    int64_t seek_ts = target;
+    int lo = 0, hi = decoder->keyframe_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (decoder->keyframes[mid] <= target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo > 0) {
+        seek_ts = decoder->keyframes[lo - 1];
+    }
+
+    // BACKWARD => the demuxer lands on a key frame at or before seek_ts,
+    // which is seek_ts itself whenever the index knew it
+    int ret = av_seek_frame(decoder->format_ctx, decoder->video_stream_index, seek_ts, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+        fprintf(stderr, "Warning: Seek to %.2fs failed\n", seconds);
+        return -1;
+    }
+
+    // frames buffered in the codec belong to the old position
+    avcodec_flush_buffers(decoder->codec_ctx);
+    av_packet_unref(decoder->packet);
+    decoder->draining = 0;
+    decoder->seek_target = seconds;
+    decoder->last_pts = seconds;
+
+    return 0;
+}
 
-    // eof
-    return NULL;
-} 
+int video_decoder_convert(VideoDecoder *decoder, VideoFrame *out) {
+    if (!decoder || !out) return 0;
+
+    out->buf = NULL;
+    out->data = NULL;
+
+    if (!decoder->sws_ctx && video_decoder_set_output_size(decoder, decoder->width, decoder->height) < 0) {
+        return 0;
+    }
+
+    AVBufferRef *buf = av_buffer_pool_get(decoder->rgb_pool);
+    if (!buf) {
+        fprintf(stderr, "Could not get RGB frame buffer\n");
+        return 0;
+    }
+
+    // convert + scale to RGB directly into the pooled buffer
+    uint8_t *dst_data[4] = {buf->data, NULL, NULL, NULL};
+    int dst_linesize[4] = {decoder->out_stride, 0, 0, 0};
+    sws_scale(
+        decoder->sws_ctx,
+        (const uint8_t * const*)decoder->frame->data,
+        decoder->frame->linesize,
+        0,
+        decoder->height,
+        dst_data,
+        dst_linesize
+    );
+
+    out->buf = buf;
+    out->data = buf->data;
+    out->stride = decoder->out_stride;
+    out->width = decoder->out_width;
+    out->height = decoder->out_height;
+    out->pts = decoder->last_pts;
+
+    return 1;
+}
+
+int video_decoder_next_frame(VideoDecoder *decoder, VideoFrame *out) {
+    if (!decoder || !out) return 0;
+
+    out->buf = NULL;
+    out->data = NULL;
+
+    if (!video_decoder_decode(decoder, NULL)) {
+        return 0;
+    }
+
+    return video_decoder_convert(decoder, out);
+}
@@ -4,6 +4,23 @@
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libswscale/swscale.h>
+#include <libavutil/buffer.h>
+
+// codec knobs applied when the decoder is opened
+// fields left at video_decoder_default_options values keep FFmpeg's behaviour
+// apart from threading, which defaults to one thread per core
+typedef struct {
+    int thread_count;                 // 0 => one per core
+    int thread_type;                  // FF_THREAD_FRAME | FF_THREAD_SLICE
+    int lowres;                       // decode at 1/2^lowres size, codec permitting
+    enum AVDiscard skip_loop_filter;  // AVDISCARD_ALL => no deblocking
+    enum AVDiscard skip_frame;        // AVDISCARD_NONREF => drop b frames etc
+    // raise lowres + skip levels by how far the source is shrunk to
+    // target_width x target_height, never lowers the settings above
+    int adaptive;
+    int target_width;
+    int target_height;
+} VideoDecoderOptions;
 
 // decoder state - holds all FFmpeg context
 typedef struct {
@@ -11,20 +28,79 @@ typedef struct {
     AVCodecContext *codec_ctx;
     struct SwsContext *sws_ctx;
     AVFrame *frame;
-    AVFrame *rgb_frame;
+    AVBufferPool *rgb_pool;  // refcounted out_stride * out_height RGB24 buffers
     AVPacket *packet;
     int video_stream_index;
-    int width;
+    int width;       // decoded size, already reduced by lowres
     int height;
+    int out_width;   // size frames are scaled to, defaults to width x height
+    int out_height;
+    int out_stride;  // bytes per output row, >= out_width * 3
     double fps;
-    unsigned char *pixel_buffer;  // Flat array: width * height * 3 bytes
+    AVRational time_base;  // of the video stream
+    int64_t start_time;    // stream timestamp of pts 0
+    double last_pts;       // seconds, of the last decoded frame
+    int draining;          // demuxer hit eof, codec is being flushed
+    double duration;       // seconds, 0 => unknown
+
+    // key frame timestamps of the video stream (stream time base), sorted
+    // seeded from the container's index at open, extended with every key
+    // frame packet read after that, so streams without an index fill in
+    // as they play
+    int64_t *keyframes;
+    int keyframe_count;
+    int keyframe_capacity;
+
+    // after a seek, frames before this are decoded but never returned
+    // < 0 => no seek in progress
+    double seek_target;
 } VideoDecoder;
 
+// borrowed view of a decoded RGB24 frame
+// data stays valid until video_frame_release, even across later next_frame
+// calls or output size changes, so frames can be handed to other threads
+typedef struct {
+    unsigned char *data;  // row y starts at data + y * stride
+    int stride;
+    int width;
+    int height;
+    double pts;           // presentation time, seconds from stream start
+    AVBufferRef *buf;     // reference into the decoder's pool
+} VideoFrame;
+
+void video_decoder_default_options(VideoDecoderOptions *options);
+
 // open video file and set up decoder
 // NULL on error
 VideoDecoder* video_decoder_open(const char *path);
 
-unsigned char* video_decoder_next_frame(VideoDecoder *decoder);
+// same with explicit codec options, NULL options => defaults
+VideoDecoder* video_decoder_open_with_options(const char *path, const VideoDecoderOptions *options);
+
+// decode + scale the next frame straight into a pooled buffer, no copies
+// 1 on success, 0 on eof/error
+int video_decoder_next_frame(VideoDecoder *decoder, VideoFrame *out);
+
+// the two halves of video_decoder_next_frame, so frames that will be dropped
+// never pay for scaling
+// decode: 1 on success, 0 on eof/error, *pts (if not NULL) in seconds
+// convert: scale + convert the last decoded frame, 1 on success, 0 on error
+int video_decoder_decode(VideoDecoder *decoder, double *pts);
+int video_decoder_convert(VideoDecoder *decoder, VideoFrame *out);
+
+// jump to seconds: the demuxer restarts at the last key frame at or before
+// it, then the codec decodes forward, returning nothing before seconds
+// only the decoder's thread may call this
+// 0 on success, -1 on error (position unchanged if the demuxer refused)
+int video_decoder_seek(VideoDecoder *decoder, double seconds);
+
+// give the frame buffer back to the pool, safe from any thread
+void video_frame_release(VideoFrame *frame);
+
+// scale + color convert straight to out_width x out_height in one swscale pass
+// call again on resize to rebuild the scaler, frames still held stay valid
+// 0 on success, -1 on error (decoder keeps its previous output size)
+int video_decoder_set_output_size(VideoDecoder *decoder, int out_width, int out_height);
 
 void video_decoder_close(VideoDecoder *decoder);
 
@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#include "pixiw.h"
+#include "pixil.h"
+#include "pixip.h"
+
+typedef struct {
+    VideoDecoder *decoder;
+    PixiRenderer *renderer;  // the tile's cells, frames drawn at its origin
+    double frame_seconds;
+
+    // glyph grid pixels the video is drawn at, centered in its tile
+    int width;
+    int height;
+
+    // a decoded frame waits in the decoder until it is due
+    int pending;
+    double pending_pts;
+    int finished;
+
+    // the layout changed => draw even if no new frame is due
+    int repaint;
+
+    // last frame drawn, kept so a repaint doesn't have to wait for the next
+    VideoFrame shown;
+
+    // output of the current tick, inside the renderer
+    struct iovec *bands;
+    int band_count;
+    size_t len;
+
+    int frames;
+    int dropped;
+} WallTile;
+
+struct VideoWall {
+    WallTile *tiles;
+    int count;
+    int threads;
+    WorkerPool *pool;  // threads - 1 tile workers, started with the wall
+
+    int cleared;  // 0 => the next tick starts with CLEAR_SCREEN
+    int first;    // tile whose bands go out first
+
+    // current tick, read by the workers
+    double now;
+    _Atomic int next_tile;
+
+    struct iovec *out;
+    int out_capacity;
+};
+
+// sum of the glyph grid pixels every video gets with grid_cols columns,
+// 0 if the tiles would be empty
+static long layout_area(const VideoWall *wall, int cols, int rows, int grid_cols,
+                        int *tile_cols, int *tile_rows) {
+    int grid_rows = (wall->count + grid_cols - 1) / grid_cols;
+
+    // a column of gutter between tiles side by side
+    *tile_cols = (cols - (grid_cols - 1)) / grid_cols;
+    *tile_rows = rows / grid_rows;
+    if (*tile_cols < 1 || *tile_rows < 1) return 0;
+
+    GlyphMode mode = pixi_renderer_options(wall->tiles[0].renderer)->glyph_mode;
+    long area = 0;
+    for (int i = 0; i < wall->count; i++) {
+        const VideoDecoder *decoder = wall->tiles[i].decoder;
+        int width, height;
+        glyph_grid_size(mode, decoder->width, decoder->height, *tile_cols, *tile_rows, &width, &height);
+        area += (long)width * height;
+    }
+    return area;
+}
+
+int video_wall_resize(VideoWall *wall, int cols, int rows) {
+    if (cols < 1 || rows < 1) return -1;
+
+    // the split with the most pixels on screen
+    int grid_cols = 0, tile_cols = 0, tile_rows = 0;
+    long best = 0;
+    for (int c = 1; c <= wall->count; c++) {
+        int tc, tr;
+        long area = layout_area(wall, cols, rows, c, &tc, &tr);
+        if (area > best) {
+            best = area;
+            grid_cols = c;
+            tile_cols = tc;
+            tile_rows = tr;
+        }
+    }
+    if (grid_cols == 0) {
+        fprintf(stderr, "%d videos don't fit %dx%d cells\n", wall->count, cols, rows);
+        return -1;
+    }
+
+    GlyphMode mode = pixi_renderer_options(wall->tiles[0].renderer)->glyph_mode;
+    int cell_width, cell_height;
+    glyph_cell_size(mode, &cell_width, &cell_height);
+
+    int out_capacity = 1;
+    for (int i = 0; i < wall->count; i++) {
+        WallTile *tile = &wall->tiles[i];
+        glyph_grid_size(mode, tile->decoder->width, tile->decoder->height, tile_cols, tile_rows,
+                        &tile->width, &tile->height);
+        if (tile->width < 1 || tile->height < 1 ||
+            video_decoder_set_output_size(tile->decoder, tile->width, tile->height) < 0 ||
+            pixi_renderer_resize(tile->renderer, tile_cols, tile_rows) < 0) {
+            fprintf(stderr, "Failed to lay out tile %d\n", i);
+            return -1;
+        }
+        out_capacity += pixi_renderer_band_count(tile->renderer, tile->height);
+
+        int image_cols = tile->width / cell_width;
+        int image_rows = (tile->height + cell_height - 1) / cell_height;
+        int row = (i / grid_cols) * tile_rows + (tile_rows - image_rows) / 2;
+        int col = (i % grid_cols) * (tile_cols + 1) + (tile_cols - image_cols) / 2;
+        pixi_renderer_set_origin(tile->renderer, row, col);
+        tile->repaint = 1;
+    }
+
+    if (out_capacity > wall->out_capacity) {
+        struct iovec *out = realloc(wall->out, out_capacity * sizeof(struct iovec));
+        if (!out) return -1;
+        wall->out = out;
+        wall->out_capacity = out_capacity;
+    }
+    wall->cleared = 0;
+    return 0;
+}
+
+VideoWall* video_wall_open(const char **paths, int count, int cols, int rows,
+                           const EncodeOptions *encode, const VideoDecoderOptions *decode) {
+    if (count < 1) return NULL;
+
+    VideoWall *wall = calloc(1, sizeof(VideoWall));
+    if (!wall) return NULL;
+    wall->tiles = calloc(count, sizeof(WallTile));
+    if (!wall->tiles) {
+        free(wall);
+        return NULL;
+    }
+    wall->count = count;
+    wall->threads = encode->threads < 1 ? 1 : encode->threads > count ? count : encode->threads;
+    wall->pool = worker_pool_create(wall->threads);
+    if (!wall->pool) {
+        free(wall->tiles);
+        free(wall);
+        return NULL;
+    }
+
+    // tiles run one thread each, the wall spreads them over its workers
+    EncodeOptions tile_encode = *encode;
+    tile_encode.delta = 1;
+    tile_encode.threads = 1;
+
+    // adaptive decoding plans for a roughly square split, the real tile
+    // size depends on every video's aspect
+    VideoDecoderOptions tile_decode = *decode;
+    int grid_cols = 1;
+    while (grid_cols * grid_cols < count) grid_cols++;
+    int grid_rows = (count + grid_cols - 1) / grid_cols;
+    int cell_width, cell_height;
+    glyph_cell_size(encode->glyph_mode, &cell_width, &cell_height);
+    tile_decode.target_width = cell_width * (cols / grid_cols);
+    tile_decode.target_height = cell_height * (rows / grid_rows);
+    if (tile_decode.thread_count == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        tile_decode.thread_count = cores > count ? (int)(cores / count) : 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        WallTile *tile = &wall->tiles[i];
+        tile->decoder = video_decoder_open_with_options(paths[i], &tile_decode);
+        if (!tile->decoder) {
+            fprintf(stderr, "Failed to open video: %s\n", paths[i]);
+            video_wall_close(wall);
+            return NULL;
+        }
+        tile->frame_seconds = tile->decoder->fps > 0 ? 1.0 / tile->decoder->fps : 1.0 / 30.0;
+        tile->renderer = pixi_renderer_create(cols, rows, &tile_encode);
+        if (!tile->renderer) {
+            video_wall_close(wall);
+            return NULL;
+        }
+    }
+
+    if (video_wall_resize(wall, cols, rows) < 0) {
+        video_wall_close(wall);
+        return NULL;
+    }
+    return wall;
+}
+
+void video_wall_close(VideoWall *wall) {
+    if (!wall) return;
+
+    worker_pool_free(wall->pool);
+    for (int i = 0; i < wall->count; i++) {
+        WallTile *tile = &wall->tiles[i];
+        video_frame_release(&tile->shown);
+        video_decoder_close(tile->decoder);
+        pixi_renderer_free(tile->renderer);
+    }
+    free(wall->tiles);
+    free(wall->out);
+    free(wall);
+}
+
+// any frame size => the tile's size, a different one is scaled
+// tiles never clear, the wall clears the whole screen for a new layout
+static void tile_encode(WallTile *tile, const unsigned char *pixels, int width, int height, int stride) {
+    int clear;
+    ssize_t len = pixi_renderer_encode(tile->renderer, pixels, width, height, stride, tile->width, tile->height,
+                                       &tile->bands, &tile->band_count, &clear);
+    if (len < 0) {
+        tile->band_count = 0;
+        len = 0;
+    }
+    tile->len = len;
+}
+
+// newest due frame => bands, frames overtaken by the next one are
+// decoded (the codec needs them) but never converted or encoded
+// finished tiles keep their last frame on screen
+static void tile_tick(WallTile *tile, double now) {
+    tile->band_count = 0;
+    tile->len = 0;
+
+    int drawn = 0;
+    while (!tile->finished) {
+        if (!tile->pending) {
+            if (!video_decoder_decode(tile->decoder, &tile->pending_pts)) {
+                tile->finished = 1;
+                break;
+            }
+            tile->pending = 1;
+        }
+        if (tile->pending_pts > now) {
+            break;
+        }
+        tile->pending = 0;
+
+        // the frame after this one is due as well
+        if (tile->pending_pts + tile->frame_seconds <= now) {
+            tile->dropped++;
+            continue;
+        }
+
+        VideoFrame frame;
+        if (!video_decoder_convert(tile->decoder, &frame)) {
+            break;
+        }
+        video_frame_release(&tile->shown);
+        tile->shown = frame;
+        tile_encode(tile, frame.data, frame.width, frame.height, frame.stride);
+        tile->frames++;
+        drawn = 1;
+        break;
+    }
+
+    // the last frame again after a resize, scaled from its old size
+    if (tile->repaint && !drawn && tile->shown.data) {
+        VideoFrame *shown = &tile->shown;
+        tile_encode(tile, shown->data, shown->width, shown->height, shown->stride);
+    }
+    tile->repaint = 0;
+}
+
+static void tick_worker(void *arg, int share) {
+    VideoWall *wall = arg;
+    int i;
+    while ((i = atomic_fetch_add(&wall->next_tile, 1)) < wall->count) {
+        tile_tick(&wall->tiles[i], wall->now);
+    }
+}
+
+size_t video_wall_tick(VideoWall *wall, double now, struct iovec **bands, int *band_count) {
+    wall->now = now;
+    atomic_store(&wall->next_tile, 0);
+
+    // tiles are handed out one at a time => a slow video keeps one worker
+    // busy while the others take the rest, the calling thread works too
+    worker_pool_run(wall->pool, tick_worker, wall, wall->threads);
+
+    // one list for one write, starting from a different tile every tick
+    struct iovec *out = wall->out;
+    int count = 0;
+    size_t len = 0;
+    if (!wall->cleared) {
+        out[count].iov_base = CLEAR_SCREEN;
+        out[count].iov_len = CLEAR_SCREEN_LEN;
+        count++;
+        len += CLEAR_SCREEN_LEN;
+        wall->cleared = 1;
+    }
+    for (int k = 0; k < wall->count; k++) {
+        WallTile *tile = &wall->tiles[(wall->first + k) % wall->count];
+        memcpy(out + count, tile->bands, tile->band_count * sizeof(struct iovec));
+        count += tile->band_count;
+        len += tile->len;
+    }
+    wall->first = (wall->first + 1) % wall->count;
+
+    *bands = out;
+    *band_count = count;
+    return len;
+}
+
+int video_wall_finished(const VideoWall *wall) {
+    for (int i = 0; i < wall->count; i++) {
+        if (!wall->tiles[i].finished) return 0;
+    }
+    return 1;
+}
+
+double video_wall_fps(const VideoWall *wall) {
+    double fps = 0.0;
+    for (int i = 0; i < wall->count; i++) {
+        if (wall->tiles[i].decoder->fps > fps) fps = wall->tiles[i].decoder->fps;
+    }
+    return fps > 0.0 ? fps : 30.0;
+}
+
+int video_wall_dropped(const VideoWall *wall) {
+    int dropped = 0;
+    for (int i = 0; i < wall->count; i++) {
+        dropped += wall->tiles[i].dropped;
+    }
+    return dropped;
+}
+
+int video_wall_shown(const VideoWall *wall) {
+    int shown = 0;
+    for (int i = 0; i < wall->count; i++) {
+        shown += wall->tiles[i].frames;
+    }
+    return shown;
+}
@@ -0,0 +1,56 @@
+#ifndef PIXIW_H
+#define PIXIW_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+#include "pixir.h"
+#include "pixiv.h"
+
+// video wall: several videos played side by side on one screen
+// every video is a tile with its own decoder and delta encoder, drawn at
+// its own origin, tiles are decoded + encoded in parallel once per tick
+// and the changed cells of all of them go out in a single write
+// tiles share one clock, each shows the newest frame that is due and
+// drops the ones it fell behind on, so a slow video can't hold up the rest
+typedef struct VideoWall VideoWall;
+
+// paths[0..count) laid out on cols x rows cells, the row/column split is
+// picked to waste the least area
+// encode options apply to every tile, delta is always on, options->threads
+// is the number of tiles worked on at once (calling thread included)
+// decode options: adaptive targets become the tile size, thread_count 0
+// splits the cores between the tiles
+// the tile workers start here and are joined by video_wall_close
+// NULL on error (any video that doesn't open)
+VideoWall* video_wall_open(const char **paths, int count, int cols, int rows,
+                           const EncodeOptions *encode, const VideoDecoderOptions *decode);
+
+void video_wall_close(VideoWall *wall);
+
+// new grid, the next tick clears the screen and repaints every tile,
+// finished ones included
+// 0 on success, -1 on error
+int video_wall_resize(VideoWall *wall, int cols, int rows);
+
+// bring every tile up to now (seconds since pts 0 on the shared clock)
+// *bands: the bytes of this tick in order, valid until the next tick,
+// *band_count can be 0 (nothing changed)
+// the first tile in the list rotates so no video is always drawn last
+// returns bytes in *bands
+size_t video_wall_tick(VideoWall *wall, double now, struct iovec **bands, int *band_count);
+
+// 1 once every video has shown its last frame
+int video_wall_finished(const VideoWall *wall);
+
+// highest frame rate among the tiles => how often ticking pays off
+double video_wall_fps(const VideoWall *wall);
+
+// frames decoded but never shown because they were due before the tick
+// that reached them
+int video_wall_dropped(const VideoWall *wall);
+
+// frames shown over all tiles
+int video_wall_shown(const VideoWall *wall);
+
+#endif